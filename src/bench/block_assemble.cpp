@@ -0,0 +1,99 @@
+// Copyright (c) 2011-2019 The Bitcoin Core developers
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <config.h>
+#include <consensus/merkle.h>
+#include <miner.h>
+#include <pow.h>
+#include <script/script.h>
+#include <txmempool.h>
+#include <validation.h>
+
+#include <test/setup_common.h>
+
+#include <memory>
+#include <vector>
+
+// 4000 chains of 25 transactions each, i.e. 100k mempool entries, which is
+// well above what fits in a single block.
+static constexpr size_t NUM_CHAINS = 4000;
+static constexpr size_t CHAIN_LENGTH = 25;
+
+// Anyone can spend, padded so that spending transactions are not undersized.
+static const CScript SCRIPT_PUB =
+    CScript() << std::vector<uint8_t>(40) << OP_DROP << OP_TRUE;
+
+static CTransactionRef MineBlock(const Config &config) {
+    std::unique_ptr<CBlockTemplate> pblocktemplate =
+        BlockAssembler(config, g_mempool).CreateNewBlock(SCRIPT_PUB);
+    auto block = std::make_shared<CBlock>(pblocktemplate->block);
+    block->hashMerkleRoot = BlockMerkleRoot(*block);
+
+    while (!CheckProofOfWork(block->GetHash(), block->nBits,
+                             config.GetChainParams().GetConsensus())) {
+        ++block->nNonce;
+        assert(block->nNonce);
+    }
+
+    bool processed = ProcessNewBlock(config, block, true, nullptr);
+    assert(processed);
+    return block->vtx[0];
+}
+
+static void AssembleBlock(benchmark::State &state) {
+    const Config &config = GetConfig();
+
+    // Mine enough blocks for the first coinbase to be spendable.
+    CTransactionRef coinbase = MineBlock(config);
+    for (int i = 0; i < COINBASE_MATURITY; i++) {
+        MineBlock(config);
+    }
+
+    // Split the coinbase into one output per chain.
+    const Amount fanoutFee = 10 * COIN / 100;
+    CMutableTransaction fanout;
+    fanout.vin.emplace_back(COutPoint(coinbase->GetId(), 0));
+    const Amount chainValue =
+        (coinbase->vout[0].nValue - fanoutFee) / int64_t(NUM_CHAINS);
+    for (size_t i = 0; i < NUM_CHAINS; i++) {
+        fanout.vout.emplace_back(chainValue, SCRIPT_PUB);
+    }
+
+    {
+        LOCK2(cs_main, g_mempool.cs);
+        TestMemPoolEntryHelper entry;
+        const CTransactionRef fanoutRef = MakeTransactionRef(fanout);
+        g_mempool.addUnchecked(
+            entry.Fee(fanoutFee).SpendsCoinbase(true).FromTx(fanoutRef));
+
+        // Spread the fees so packages have a range of ancestor fee rates.
+        for (size_t i = 0; i < NUM_CHAINS; i++) {
+            const Amount fee = int64_t(1 + i % 100) * 100 * SATOSHI;
+            COutPoint prevout(fanoutRef->GetId(), i);
+            Amount value = chainValue;
+            for (size_t j = 0; j < CHAIN_LENGTH; j++) {
+                value -= fee;
+                CMutableTransaction tx;
+                tx.vin.emplace_back(prevout);
+                tx.vout.emplace_back(value, SCRIPT_PUB);
+                const CTransactionRef txRef = MakeTransactionRef(tx);
+                g_mempool.addUnchecked(
+                    entry.Fee(fee).SpendsCoinbase(false).FromTx(txRef));
+                prevout = COutPoint(txRef->GetId(), 0);
+            }
+        }
+    }
+
+    while (state.KeepRunning()) {
+        BlockAssembler(config, g_mempool).CreateNewBlock(SCRIPT_PUB);
+    }
+
+    LOCK(g_mempool.cs);
+    g_mempool.clear();
+}
+
+BENCHMARK(AssembleBlock, 1);
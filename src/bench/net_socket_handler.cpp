@@ -0,0 +1,118 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <chainparams.h>
+#include <config.h>
+#include <hash.h>
+#include <net.h>
+#include <netbase.h>
+#include <netmessagemaker.h>
+#include <protocol.h>
+#include <streams.h>
+#include <util/system.h>
+
+#include <cstring>
+#include <vector>
+
+struct CConnmanTest : public CConnman {
+    using CConnman::CConnman;
+
+    void AddNode(CNode *pnode) {
+#ifdef USE_EPOLL
+        RegisterNodeSocket(pnode);
+#endif
+        LOCK(cs_vNodes);
+        vNodes.push_back(pnode);
+    }
+
+    void ClearNodes() {
+        LOCK(cs_vNodes);
+        for (CNode *pnode : vNodes) {
+            delete pnode;
+        }
+        vNodes.clear();
+    }
+
+    void RunSocketHandler() { SocketHandler(); }
+};
+
+static std::vector<uint8_t> SerializePing(const Config &config) {
+    CSerializedNetMsg msg = CNetMsgMaker(INIT_PROTO_VERSION)
+                                .Make(NetMsgType::PING, uint64_t(0));
+    uint256 hash = Hash(msg.data.data(), msg.data.data() + msg.data.size());
+    CMessageHeader hdr(config.GetChainParams().NetMagic(), msg.command.c_str(),
+                       msg.data.size());
+    memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
+
+    std::vector<uint8_t> bytes;
+    CVectorWriter{SER_NETWORK, INIT_PROTO_VERSION, bytes, 0, hdr};
+    bytes.insert(bytes.end(), msg.data.begin(), msg.data.end());
+    return bytes;
+}
+
+/**
+ * Measure the latency of one socket handler loop iteration picking up a
+ * message from one peer, while all the other peers are idle.
+ */
+static void SocketHandler(benchmark::State &state, size_t nPeers) {
+    RaiseFileDescriptorLimit(2 * nPeers + 100);
+
+    const Config &config = GetConfig();
+    CConnmanTest connman(config, 0x1337, 0x1337);
+
+    std::vector<CNode *> nodes;
+    std::vector<SOCKET> remotes;
+    for (size_t i = 0; i < nPeers; i++) {
+        int fds[2];
+        bool created = socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0;
+        assert(created);
+        CNode *pnode = new CNode(i, NODE_NETWORK, 0, fds[0], CAddress(), 0, 0,
+                                 CAddress(), "", true);
+        connman.AddNode(pnode);
+        nodes.push_back(pnode);
+        remotes.push_back(fds[1]);
+    }
+
+    const std::vector<uint8_t> ping = SerializePing(config);
+
+    size_t i = 0;
+    while (state.KeepRunning()) {
+        CNode *pnode = nodes[i % nPeers];
+        ssize_t nBytes =
+            send(remotes[i % nPeers], ping.data(), ping.size(), 0);
+        assert(nBytes == ssize_t(ping.size()));
+
+        while (pnode->nProcessQueueSize == 0) {
+            connman.RunSocketHandler();
+        }
+
+        LOCK(pnode->cs_vProcessMsg);
+        pnode->vProcessMsg.clear();
+        pnode->nProcessQueueSize = 0;
+        pnode->fPauseRecv = false;
+        i++;
+    }
+
+    connman.ClearNodes();
+    for (SOCKET &remote : remotes) {
+        CloseSocket(remote);
+    }
+}
+
+static void SocketHandler10Peers(benchmark::State &state) {
+    SocketHandler(state, 10);
+}
+
+static void SocketHandler100Peers(benchmark::State &state) {
+    SocketHandler(state, 100);
+}
+
+static void SocketHandler400Peers(benchmark::State &state) {
+    SocketHandler(state, 400);
+}
+
+BENCHMARK(SocketHandler10Peers, 50 * 1000);
+BENCHMARK(SocketHandler100Peers, 20 * 1000);
+BENCHMARK(SocketHandler400Peers, 5 * 1000);
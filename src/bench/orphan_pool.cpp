@@ -0,0 +1,71 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <bench/bench.h>
+#include <random.h>
+#include <txorphanpool.h>
+
+#include <vector>
+
+static constexpr size_t NUM_ORPHANS = 5000;
+static constexpr NodeId NUM_PEERS = 125;
+
+static std::vector<CTransactionRef> CreateOrphans(size_t count) {
+    FastRandomContext rng(true);
+    std::vector<CTransactionRef> orphans;
+    orphans.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(2);
+        for (CTxIn &txin : tx.vin) {
+            txin.prevout = COutPoint(TxId(rng.rand256()), 0);
+            txin.scriptSig << OP_1;
+        }
+        tx.vout.resize(1);
+        tx.vout[0].nValue = 1 * COIN;
+        tx.vout[0].scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+        orphans.push_back(MakeTransactionRef(tx));
+    }
+    return orphans;
+}
+
+// Simulate an orphan flood: peers fill the pool, which is trimmed to the
+// default limits after each insertion, then all the peers disconnect.
+static void OrphanPoolFlood(benchmark::State &state) {
+    const std::vector<CTransactionRef> orphans = CreateOrphans(NUM_ORPHANS);
+    FastRandomContext rng(true);
+    CTxOrphanPool pool;
+
+    while (state.KeepRunning()) {
+        for (size_t i = 0; i < orphans.size(); i++) {
+            pool.AddTx(orphans[i], i % NUM_PEERS, 0);
+            pool.LimitSize(1000, 10000000, rng);
+        }
+        for (NodeId peer = 0; peer < NUM_PEERS; peer++) {
+            pool.EraseForPeer(peer);
+        }
+    }
+}
+
+// Lookup of the orphans spending a given outpoint, as done for every accepted
+// transaction.
+static void OrphanPoolGetChildren(benchmark::State &state) {
+    const std::vector<CTransactionRef> orphans = CreateOrphans(NUM_ORPHANS);
+    CTxOrphanPool pool;
+    for (size_t i = 0; i < orphans.size(); i++) {
+        pool.AddTx(orphans[i], i % NUM_PEERS, 0);
+    }
+
+    std::vector<TxId> vChildren;
+    while (state.KeepRunning()) {
+        for (const CTransactionRef &tx : orphans) {
+            vChildren.clear();
+            pool.GetChildren(tx->vin[0].prevout, vChildren);
+            pool.GetChildren(COutPoint(tx->GetId(), 0), vChildren);
+        }
+    }
+}
+
+BENCHMARK(OrphanPoolFlood, 10);
+BENCHMARK(OrphanPoolGetChildren, 100);
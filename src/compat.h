@@ -44,9 +44,18 @@
 #include <sys/select.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif
 
+// On Linux, the socket handler uses epoll instead of select, which lifts the
+// FD_SETSIZE limit on the number of sockets.
+#ifdef HAVE_SYS_EPOLL_H
+#define USE_EPOLL
+#include <poll.h>
+#include <sys/epoll.h>
+#endif
+
 #ifndef WIN32
 typedef unsigned int SOCKET;
 #include <cerrno>
@@ -83,7 +92,7 @@ typedef char *sockopt_arg_type;
 #endif
 
 static bool inline IsSelectableSocket(const SOCKET &s) {
-#ifdef WIN32
+#if defined(WIN32) || defined(USE_EPOLL)
     return true;
 #else
     return (s < FD_SETSIZE);
@@ -70,6 +70,7 @@
 #endif
 #include <cstdint>
 #include <cstdio>
+#include <limits>
 #include <memory>
 
 static const bool DEFAULT_PROXYRANDOMIZE = true;
@@ -456,6 +457,11 @@ void SetupServerArgs() {
                            "memory (default: %u)",
                            DEFAULT_MAX_ORPHAN_TRANSACTIONS),
                  false, OptionsCategory::OPTIONS);
+    gArgs.AddArg("-maxorphantxsize=<n>",
+                 strprintf("Keep the unconnectable transactions in memory "
+                           "below <n> megabytes (default: %u)",
+                           DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE),
+                 false, OptionsCategory::OPTIONS);
     gArgs.AddArg("-mempoolexpiry=<n>",
                  strprintf("Do not keep transactions in the mempool longer "
                            "than <n> hours (default: %u)",
@@ -605,6 +611,12 @@ void SetupServerArgs() {
             "Maximum per-connection send buffer, <n>*1000 bytes (default: %u)",
             DEFAULT_MAXSENDBUFFER),
         false, OptionsCategory::CONNECTION);
+    gArgs.AddArg("-msghandlerthreads=<n>",
+                 strprintf("Number of threads processing peer messages, each "
+                           "peer being handled by a single thread (1 to %d, "
+                           "default: %d)",
+                           MAX_MSGHANDLER_THREADS, DEFAULT_MSGHANDLER_THREADS),
+                 false, OptionsCategory::CONNECTION);
     gArgs.AddArg(
         "-maxtimeadjustment",
         strprintf("Maximum allowed median peer time offset adjustment. Local "
@@ -1533,17 +1545,20 @@ bool AppInitParameterInteraction(Config &config) {
     }
 
     // Make sure enough file descriptors are available
-    int nBind = std::max(nUserBind, size_t(1));
     nUserMaxConnections =
         gArgs.GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS);
     nMaxConnections = std::max(nUserMaxConnections, 0);
 
     // Trim requested connection counts, to fit into system limitations
+#ifndef USE_EPOLL
+    // select() can only handle sockets below FD_SETSIZE.
+    int nBind = std::max(nUserBind, size_t(1));
     nMaxConnections =
         std::max(std::min(nMaxConnections, FD_SETSIZE - nBind -
                                                MIN_CORE_FILEDESCRIPTORS -
                                                MAX_ADDNODE_CONNECTIONS),
                  0);
+#endif
     nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS +
                                    MAX_ADDNODE_CONNECTIONS);
     if (nFD < MIN_CORE_FILEDESCRIPTORS) {
@@ -1676,6 +1691,18 @@ bool AppInitParameterInteraction(Config &config) {
                                    std::ceil(nMempoolSizeMin / 1000000.0)));
     }
 
+    // orphan pool limits
+    int64_t nMaxOrphanTxSize = gArgs.GetArg(
+        "-maxorphantxsize", DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE);
+    if (nMaxOrphanTxSize < 0 ||
+        uint64_t(nMaxOrphanTxSize) >
+            std::numeric_limits<size_t>::max() / 1000000) {
+        return InitError(
+            strprintf(_("Invalid amount for -maxorphantxsize=<n>: '%d'"),
+                      nMaxOrphanTxSize));
+    }
+    nMaxOrphanTxBytes = nMaxOrphanTxSize * 1000000;
+
     // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
     nScriptCheckThreads = gArgs.GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
     if (nScriptCheckThreads <= 0) {
@@ -2481,6 +2508,8 @@ bool AppInitMain(Config &config, RPCServer &rpcServer,
         1000 * gArgs.GetArg("-maxsendbuffer", DEFAULT_MAXSENDBUFFER);
     connOptions.nReceiveFloodSize =
         1000 * gArgs.GetArg("-maxreceivebuffer", DEFAULT_MAXRECEIVEBUFFER);
+    connOptions.nMsgHandlerThreads =
+        gArgs.GetArg("-msghandlerthreads", DEFAULT_MSGHANDLER_THREADS);
     connOptions.m_added_nodes = gArgs.GetArgs("-addnode");
 
     connOptions.nMaxOutboundTimeframe = nMaxOutboundTimeframe;
@@ -31,7 +31,9 @@
 
 #include <algorithm>
 #include <queue>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 // Unconfirmed transactions in the memory pool often depend on other
 // transactions in the memory pool. When we select transactions from the
@@ -115,6 +117,32 @@ BlockAssembler::BlockAssembler(const Config &config, const CTxMemPool &_mempool)
     : BlockAssembler(config.GetChainParams(), _mempool,
                      DefaultOptions(config)) {}
 
+/**
+ * Sort the block template entries, except the coinbase, by txid. The txids are
+ * copied to a contiguous array first, so that the comparisons don't need to
+ * dereference the transactions.
+ */
+static void SortEntriesByTxId(std::vector<CBlockTemplateEntry> &entries) {
+    if (entries.size() < 2) {
+        return;
+    }
+
+    std::vector<std::pair<TxId, size_t>> keys;
+    keys.reserve(entries.size() - 1);
+    for (size_t i = 1; i < entries.size(); i++) {
+        keys.emplace_back(entries[i].tx->GetId(), i);
+    }
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<CBlockTemplateEntry> sorted;
+    sorted.reserve(entries.size());
+    sorted.push_back(std::move(entries[0]));
+    for (const auto &key : keys) {
+        sorted.push_back(std::move(entries[key.second]));
+    }
+    entries.swap(sorted);
+}
+
 void BlockAssembler::resetBlock() {
     inBlock.clear();
 
@@ -177,10 +205,7 @@ BlockAssembler::CreateNewBlock(const CScript &scriptPubKeyIn) {
     if (IsMagneticAnomalyEnabled(consensusParams, pindexPrev)) {
         // If magnetic anomaly is enabled, we make sure transaction are
         // canonically ordered.
-        std::sort(std::begin(pblocktemplate->entries) + 1,
-                  std::end(pblocktemplate->entries),
-                  [](const CBlockTemplateEntry &a, const CBlockTemplateEntry &b)
-                      -> bool { return a.tx->GetId() < b.tx->GetId(); });
+        SortEntriesByTxId(pblocktemplate->entries);
     }
 
     // Copy all the transactions refs into the block
@@ -336,29 +361,78 @@ void BlockAssembler::AddToBlock(CTxMemPool::txiter iter) {
     }
 }
 
+const CTxMemPoolModifiedEntry *CTxMemPoolModifiedSet::best() {
+    while (!heap.empty()) {
+        const Snapshot &top = heap.front();
+        auto it = entries.find(top.entry);
+        if (it != entries.end() && it->second.nVersion == top.nVersion) {
+            return &it->second.entry;
+        }
+
+        // This snapshot is stale, the entry was erased or modified since.
+        std::pop_heap(heap.begin(), heap.end(),
+                      CompareSnapshotByAncestorFee());
+        heap.pop_back();
+    }
+
+    assert(entries.empty());
+    return nullptr;
+}
+
+void CTxMemPoolModifiedSet::UpdateForParentInclusion(
+    CTxMemPool::txiter iter, CTxMemPool::txiter parent) {
+    auto ret = entries.emplace(
+        &*iter, ModifiedEntry{CTxMemPoolModifiedEntry(iter), nNextVersion});
+    ModifiedEntry &modified = ret.first->second;
+    if (ret.second) {
+        modified.entry.nSizeWithAncestors -= parent->GetTxSize();
+        modified.entry.nModFeesWithAncestors -= parent->GetModifiedFee();
+        modified.entry.nSigOpCountWithAncestors -= parent->GetSigOpCount();
+    } else {
+        update_for_parent_inclusion update(parent);
+        update(modified.entry);
+        modified.nVersion = nNextVersion;
+    }
+    nNextVersion++;
+
+    Snapshot snapshot;
+    CompareTxMemPoolEntryByAncestorFee().GetModFeeAndSize(
+        modified.entry, snapshot.modFee, snapshot.size);
+    snapshot.entry = &*iter;
+    snapshot.nVersion = modified.nVersion;
+    heap.push_back(snapshot);
+    std::push_heap(heap.begin(), heap.end(), CompareSnapshotByAncestorFee());
+}
+
 int BlockAssembler::UpdatePackagesForAdded(
     const CTxMemPool::setEntries &alreadyAdded,
-    indexed_modified_transaction_set &mapModifiedTx) {
+    CTxMemPoolModifiedSet &mapModifiedTx) {
     int nDescendantsUpdated = 0;
+    // Walk the descendants through the mempool child links rather than with
+    // CTxMemPool::CalculateDescendants: a hashed visited set is much cheaper
+    // than the ordered one when a transaction has many descendants.
+    std::unordered_set<const CTxMemPoolEntry *> visited;
+    std::vector<CTxMemPool::txiter> stage;
     for (CTxMemPool::txiter it : alreadyAdded) {
-        CTxMemPool::setEntries descendants;
-        mempool->CalculateDescendants(it, descendants);
-        // Insert all descendants (not yet in block) into the modified set.
-        for (CTxMemPool::txiter desc : descendants) {
-            if (alreadyAdded.count(desc)) {
-                continue;
-            }
-
-            ++nDescendantsUpdated;
-            modtxiter mit = mapModifiedTx.find(desc);
-            if (mit == mapModifiedTx.end()) {
-                CTxMemPoolModifiedEntry modEntry(desc);
-                modEntry.nSizeWithAncestors -= it->GetTxSize();
-                modEntry.nModFeesWithAncestors -= it->GetModifiedFee();
-                modEntry.nSigOpCountWithAncestors -= it->GetSigOpCount();
-                mapModifiedTx.insert(modEntry);
-            } else {
-                mapModifiedTx.modify(mit, update_for_parent_inclusion(it));
+        visited.clear();
+        stage.assign(1, it);
+        while (!stage.empty()) {
+            CTxMemPool::txiter entry = stage.back();
+            stage.pop_back();
+            for (CTxMemPool::txiter desc : mempool->GetMemPoolChildren(entry)) {
+                if (!visited.insert(&*desc).second) {
+                    continue;
+                }
+
+                stage.push_back(desc);
+                // Insert all descendants (not yet in block) into the modified
+                // set.
+                if (alreadyAdded.count(desc)) {
+                    continue;
+                }
+
+                ++nDescendantsUpdated;
+                mapModifiedTx.UpdateForParentInclusion(desc, it);
             }
         }
     }
@@ -374,9 +448,9 @@ int BlockAssembler::UpdatePackagesForAdded(
 // It's currently guaranteed to fail again, but as a belt-and-suspenders check
 // we put it in failedTx and avoid re-evaluation, since the re-evaluation would
 // be using cached size/sigops/fee values that are not actually correct.
-bool BlockAssembler::SkipMapTxEntry(
-    CTxMemPool::txiter it, indexed_modified_transaction_set &mapModifiedTx,
-    CTxMemPool::setEntries &failedTx) {
+bool BlockAssembler::SkipMapTxEntry(CTxMemPool::txiter it,
+                                    CTxMemPoolModifiedSet &mapModifiedTx,
+                                    CTxMemPool::setEntries &failedTx) {
     assert(it != mempool->mapTx.end());
     return mapModifiedTx.count(it) || inBlock.count(it) || failedTx.count(it);
 }
@@ -415,7 +489,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected,
 
     // mapModifiedTx will store sorted packages after they are modified because
     // some of their txs are already in the block.
-    indexed_modified_transaction_set mapModifiedTx;
+    CTxMemPoolModifiedSet mapModifiedTx;
     // Keep track of entries that failed inclusion, to avoid duplicate work.
     CTxMemPool::setEntries failedTx;
 
@@ -447,7 +521,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected,
         // the next entry from mapTx, or the best from mapModifiedTx?
         bool fUsingModified = false;
 
-        modtxscoreiter modit = mapModifiedTx.get<ancestor_score>().begin();
+        const CTxMemPoolModifiedEntry *modit = mapModifiedTx.best();
         if (mi == mempool->mapTx.get<ancestor_score>().end()) {
             // We're out of entries in mapTx; use the entry from mapModifiedTx
             iter = modit->iter;
@@ -455,9 +529,8 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected,
         } else {
             // Try to compare the mapTx entry to the mapModifiedTx entry.
             iter = mempool->mapTx.project<0>(mi);
-            if (modit != mapModifiedTx.get<ancestor_score>().end() &&
-                CompareTxMemPoolEntryByAncestorFee()(
-                    *modit, CTxMemPoolModifiedEntry(iter))) {
+            if (modit && CompareTxMemPoolEntryByAncestorFee()(
+                             *modit, CTxMemPoolModifiedEntry(iter))) {
                 // The best entry in mapModifiedTx has higher score than the one
                 // from mapTx. Switch which transaction (package) to consider
                 iter = modit->iter;
@@ -490,7 +563,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected,
                 // Since we always look at the best entry in mapModifiedTx, we
                 // must erase failed entries so that we can consider the next
                 // best entry on the next loop iteration
-                mapModifiedTx.get<ancestor_score>().erase(modit);
+                mapModifiedTx.erase(iter);
                 failedTx.insert(iter);
             }
             continue;
@@ -504,7 +577,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected,
                 // Since we always look at the best entry in mapModifiedTx, we
                 // must erase failed entries so that we can consider the next
                 // best entry on the next loop iteration
-                mapModifiedTx.get<ancestor_score>().erase(modit);
+                mapModifiedTx.erase(iter);
                 failedTx.insert(iter);
             }
 
@@ -532,7 +605,7 @@ void BlockAssembler::addPackageTxs(int &nPackagesSelected,
         // Test if all tx's are Final.
         if (!TestPackageTransactions(ancestors)) {
             if (fUsingModified) {
-                mapModifiedTx.get<ancestor_score>().erase(modit);
+                mapModifiedTx.erase(iter);
                 failedTx.insert(iter);
             }
             continue;
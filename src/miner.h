@@ -9,11 +9,10 @@
 #include <primitives/block.h>
 #include <txmempool.h>
 
-#include <boost/multi_index/ordered_index.hpp>
-#include <boost/multi_index_container.hpp>
-
 #include <cstdint>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 class CBlockIndex;
 class CChainParams;
@@ -65,26 +64,6 @@ struct CTxMemPoolModifiedEntry {
     int64_t nSigOpCountWithAncestors;
 };
 
-/**
- * Comparator for CTxMemPool::txiter objects.
- * It simply compares the internal memory address of the CTxMemPoolEntry object
- * pointed to. This means it has no meaning, and is only useful for using them
- * as key in other indexes.
- */
-struct CompareCTxMemPoolIter {
-    bool operator()(const CTxMemPool::txiter &a,
-                    const CTxMemPool::txiter &b) const {
-        return &(*a) < &(*b);
-    }
-};
-
-struct modifiedentry_iter {
-    typedef CTxMemPool::txiter result_type;
-    result_type operator()(const CTxMemPoolModifiedEntry &entry) const {
-        return entry.iter;
-    }
-};
-
 // A comparator that sorts transactions based on number of ancestors.
 // This is sufficient to sort an ancestor package in an order that is valid
 // to appear in a block.
@@ -98,24 +77,6 @@ struct CompareTxIterByAncestorCount {
     }
 };
 
-typedef boost::multi_index_container<
-    CTxMemPoolModifiedEntry,
-    boost::multi_index::indexed_by<
-        boost::multi_index::ordered_unique<modifiedentry_iter,
-                                           CompareCTxMemPoolIter>,
-        // sorted by modified ancestor fee rate
-        boost::multi_index::ordered_non_unique<
-            // Reuse same tag from CTxMemPool's similar index
-            boost::multi_index::tag<ancestor_score>,
-            boost::multi_index::identity<CTxMemPoolModifiedEntry>,
-            CompareTxMemPoolEntryByAncestorFee>>>
-    indexed_modified_transaction_set;
-
-typedef indexed_modified_transaction_set::nth_index<0>::type::iterator
-    modtxiter;
-typedef indexed_modified_transaction_set::index<ancestor_score>::type::iterator
-    modtxscoreiter;
-
 struct update_for_parent_inclusion {
     explicit update_for_parent_inclusion(CTxMemPool::txiter it) : iter(it) {}
 
@@ -128,6 +89,73 @@ struct update_for_parent_inclusion {
     CTxMemPool::txiter iter;
 };
 
+/**
+ * The set of mempool entries whose ancestor state was modified because some of
+ * their ancestors are already in the block, sorted by modified ancestor fee
+ * rate.
+ *
+ * The current state of each entry is kept in a hash map, and the ordering in a
+ * binary heap over a flat vector. Modifying or erasing an entry does not touch
+ * the heap: a new snapshot is pushed instead, and stale snapshots are dropped
+ * lazily when they reach the top.
+ */
+class CTxMemPoolModifiedSet {
+public:
+    bool empty() const { return entries.empty(); }
+    size_t count(CTxMemPool::txiter iter) const {
+        return entries.count(&*iter);
+    }
+
+    /**
+     * Return the entry with the best modified ancestor fee rate, or nullptr if
+     * the set is empty. The returned pointer is invalidated by any other call
+     * to a non-const method.
+     */
+    const CTxMemPoolModifiedEntry *best();
+
+    /**
+     * Update the state of iter, adding it to the set if needed, to account for
+     * the inclusion of its ancestor parent in the block.
+     */
+    void UpdateForParentInclusion(CTxMemPool::txiter iter,
+                                  CTxMemPool::txiter parent);
+
+    void erase(CTxMemPool::txiter iter) { entries.erase(&*iter); }
+
+private:
+    //! A heap node. The sort key is computed once when the node is pushed so
+    //! that heap operations never need to dereference the mempool entry,
+    //! except to break ties.
+    struct Snapshot {
+        double modFee;
+        double size;
+        const CTxMemPoolEntry *entry;
+        uint64_t nVersion;
+    };
+
+    struct CompareSnapshotByAncestorFee {
+        // Same ordering as CompareTxMemPoolEntryByAncestorFee, reversed
+        // because the heap keeps the greatest element on top.
+        bool operator()(const Snapshot &a, const Snapshot &b) const {
+            double f1 = a.modFee * b.size;
+            double f2 = a.size * b.modFee;
+            if (f1 == f2) {
+                return b.entry->GetTx().GetId() < a.entry->GetTx().GetId();
+            }
+            return f1 < f2;
+        }
+    };
+
+    struct ModifiedEntry {
+        CTxMemPoolModifiedEntry entry;
+        uint64_t nVersion;
+    };
+
+    std::unordered_map<const CTxMemPoolEntry *, ModifiedEntry> entries;
+    std::vector<Snapshot> heap;
+    uint64_t nNextVersion = 0;
+};
+
 /** Generate a new block, without valid proof-of-work */
 class BlockAssembler {
 private:
@@ -215,7 +243,7 @@ private:
      * or if the transaction's cached data in mapTx is incorrect.
      */
     bool SkipMapTxEntry(CTxMemPool::txiter it,
-                        indexed_modified_transaction_set &mapModifiedTx,
+                        CTxMemPoolModifiedSet &mapModifiedTx,
                         CTxMemPool::setEntries &failedTx)
         EXCLUSIVE_LOCKS_REQUIRED(mempool->cs);
     /** Sort the package in an order that is valid to appear in a block */
@@ -227,7 +255,7 @@ private:
      * updated descendants.
      */
     int UpdatePackagesForAdded(const CTxMemPool::setEntries &alreadyAdded,
-                               indexed_modified_transaction_set &mapModifiedTx)
+                               CTxMemPoolModifiedSet &mapModifiedTx)
         EXCLUSIVE_LOCKS_REQUIRED(mempool->cs);
 };
 
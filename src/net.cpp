@@ -452,6 +452,9 @@ CNode *CConnman::ConnectNode(CAddress addrConnect, const char *pszDest,
                              addrConnect, CalculateKeyedNetGroup(addrConnect),
                              nonce, addr_bind, pszDest ? pszDest : "", false);
     pnode->AddRef();
+#ifdef USE_EPOLL
+    RegisterNodeSocket(pnode);
+#endif
 
     return pnode;
 }
@@ -715,26 +718,62 @@ const uint256 &CNetMessage::GetMessageHash() const {
     return data_hash;
 }
 
+#ifdef WIN32
+// Windows has no sendmsg(), send the buffers one at a time.
+static constexpr size_t MAX_SEND_BUFFERS = 1;
+#else
+// Send up to that many buffers of the send queue with a single system call,
+// which is well below IOV_MAX on all the supported platforms.
+static constexpr size_t MAX_SEND_BUFFERS = 64;
+#endif
+
 size_t CConnman::SocketSendData(CNode *pnode) const
     EXCLUSIVE_LOCKS_REQUIRED(pnode->cs_vSend) {
     size_t nSentSize = 0;
     size_t nMsgCount = 0;
 
-    for (const auto &data : pnode->vSendMsg) {
-        assert(data.size() > pnode->nSendOffset);
-        int nBytes = 0;
+    while (nMsgCount < pnode->vSendMsg.size()) {
+        // Gather the pending buffers, the headers being owned by the peer and
+        // the payloads possibly shared with other peers.
+        const char *pBuffers[MAX_SEND_BUFFERS];
+        size_t nBufferSizes[MAX_SEND_BUFFERS];
+        size_t nBuffers = 0;
+        size_t nBytesToSend = 0;
+        size_t nOffset = pnode->nSendOffset;
+        for (auto it = pnode->vSendMsg.begin() + nMsgCount;
+             it != pnode->vSendMsg.end() && nBuffers < MAX_SEND_BUFFERS;
+             ++it) {
+            const std::vector<uint8_t> &data = it->Get();
+            assert(data.size() > nOffset);
+            pBuffers[nBuffers] =
+                reinterpret_cast<const char *>(data.data()) + nOffset;
+            nBufferSizes[nBuffers] = data.size() - nOffset;
+            nBytesToSend += nBufferSizes[nBuffers];
+            nBuffers++;
+            nOffset = 0;
+        }
 
+        int nBytes = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET) {
                 break;
             }
 
-            nBytes = send(pnode->hSocket,
-                          reinterpret_cast<const char *>(data.data()) +
-                              pnode->nSendOffset,
-                          data.size() - pnode->nSendOffset,
+#ifdef WIN32
+            nBytes = send(pnode->hSocket, pBuffers[0], nBufferSizes[0],
                           MSG_NOSIGNAL | MSG_DONTWAIT);
+#else
+            struct iovec iov[MAX_SEND_BUFFERS];
+            for (size_t i = 0; i < nBuffers; i++) {
+                iov[i].iov_base = const_cast<char *>(pBuffers[i]);
+                iov[i].iov_len = nBufferSizes[i];
+            }
+            struct msghdr msg = {};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = nBuffers;
+            nBytes = sendmsg(pnode->hSocket, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+#endif
         }
 
         if (nBytes == 0) {
@@ -757,17 +796,27 @@ size_t CConnman::SocketSendData(CNode *pnode) const
         assert(nBytes > 0);
         pnode->nLastSend = GetSystemTimeInSeconds();
         pnode->nSendBytes += nBytes;
-        pnode->nSendOffset += nBytes;
         nSentSize += nBytes;
-        if (pnode->nSendOffset != data.size()) {
-            // could not send full message; stop sending more
-            break;
+
+        // Pop the buffers which were fully sent.
+        size_t nBytesLeft = nBytes;
+        for (size_t i = 0; i < nBuffers && nBytesLeft > 0; i++) {
+            if (nBytesLeft < nBufferSizes[i]) {
+                pnode->nSendOffset += nBytesLeft;
+                break;
+            }
+
+            nBytesLeft -= nBufferSizes[i];
+            pnode->nSendOffset = 0;
+            pnode->nSendSize -= pnode->vSendMsg[nMsgCount].size();
+            pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
+            nMsgCount++;
         }
 
-        pnode->nSendOffset = 0;
-        pnode->nSendSize -= data.size();
-        pnode->fPauseSend = pnode->nSendSize > nSendBufferMaxSize;
-        nMsgCount++;
+        if (size_t(nBytes) != nBytesToSend) {
+            // could not send everything; stop sending more
+            break;
+        }
     }
 
     pnode->vSendMsg.erase(pnode->vSendMsg.begin(),
@@ -1048,6 +1097,9 @@ void CConnman::AcceptConnection(const ListenSocket &hListenSocket) {
                   CalculateKeyedNetGroup(addr), nonce, addr_bind, "", true);
     pnode->AddRef();
     pnode->fWhitelisted = whitelisted;
+#ifdef USE_EPOLL
+    RegisterNodeSocket(pnode);
+#endif
 
     pnode->m_prefer_evict = bannedlevel > 0;
     m_msgproc->InitializeNode(*config, pnode);
@@ -1168,14 +1220,121 @@ void CConnman::InactivityCheck(CNode *pnode) {
     }
 }
 
-void CConnman::SocketHandler() {
+//! How long to wait for socket events. This is also how often receiving from
+//! paused peers is attempted again.
+static constexpr int SOCKET_EVENTS_TIMEOUT_MS = 50;
+
+#ifdef USE_EPOLL
+//! Maximum number of events to retrieve from epoll at once.
+static constexpr int MAX_SOCKET_EVENTS = 1024;
+
+static bool EpollControl(int epollfd, int op, SOCKET hSocket, void *ptr,
+                         uint32_t events) {
+    struct epoll_event event = {};
+    event.events = events;
+    event.data.ptr = ptr;
+    if (epoll_ctl(epollfd, op, hSocket, &event) == SOCKET_ERROR) {
+        LogPrintf("socket epoll_ctl error %s\n",
+                  NetworkErrorString(WSAGetLastError()));
+        return false;
+    }
+    return true;
+}
+
+// Node sockets are edge-triggered, listening sockets are level-triggered.
+static constexpr uint32_t NODE_SOCKET_EVENTS = EPOLLIN | EPOLLRDHUP | EPOLLET;
+
+void CConnman::RegisterNodeSocket(CNode *pnode) {
+    LOCK(pnode->cs_hSocket);
+    if (pnode->hSocket == INVALID_SOCKET) {
+        return;
+    }
+    if (!EpollControl(epollfd, EPOLL_CTL_ADD, pnode->hSocket, pnode,
+                      NODE_SOCKET_EVENTS)) {
+        pnode->fDisconnect = true;
+    }
+}
+
+void CConnman::UpdateSendReadiness(CNode *pnode) {
+    const bool fWantSend = !pnode->vSendMsg.empty();
+    if (fWantSend == pnode->fSocketSendArmed) {
+        return;
+    }
+
+    LOCK(pnode->cs_hSocket);
+    if (pnode->hSocket == INVALID_SOCKET) {
+        return;
+    }
+    const uint32_t events =
+        NODE_SOCKET_EVENTS | (fWantSend ? uint32_t(EPOLLOUT) : 0);
+    if (EpollControl(epollfd, EPOLL_CTL_MOD, pnode->hSocket, pnode, events)) {
+        pnode->fSocketSendArmed = fWantSend;
+    }
+}
+
+bool CConnman::SocketEvents() {
+    // Sockets are registered when they are created and only report changes
+    // in readiness, so there is no per-socket work here.
+    // Don't wait if some sockets are known to have data left to receive.
+    int nTimeout = SOCKET_EVENTS_TIMEOUT_MS;
+    for (CNode *pnode : vSocketReadyNodes) {
+        if (!pnode->fSocketRecvReady || pnode->fPauseRecv) {
+            continue;
+        }
+        LOCK(pnode->cs_vSend);
+        if (pnode->vSendMsg.empty()) {
+            nTimeout = 0;
+            break;
+        }
+    }
+
+    std::vector<struct epoll_event> events(MAX_SOCKET_EVENTS);
+    int nEvents = epoll_wait(epollfd, events.data(), events.size(), nTimeout);
+    if (interruptNet) {
+        return false;
+    }
+
+    if (nEvents == SOCKET_ERROR) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEINTR) {
+            LogPrintf("socket epoll error %s\n", NetworkErrorString(nErr));
+        }
+        return interruptNet.sleep_for(
+            std::chrono::milliseconds(SOCKET_EVENTS_TIMEOUT_MS));
+    }
+
+    for (int i = 0; i < nEvents; i++) {
+        const struct epoll_event &event = events[i];
+        auto itListen =
+            std::find_if(vhListenSocket.begin(), vhListenSocket.end(),
+                         [&](const ListenSocket &hListenSocket) {
+                             return &hListenSocket == event.data.ptr;
+                         });
+        if (itListen != vhListenSocket.end()) {
+            AcceptConnection(*itListen);
+            continue;
+        }
+
+        // Nodes are only deleted by this thread, and the events of a socket
+        // stop when it is closed, so the node is still alive.
+        CNode *pnode = static_cast<CNode *>(event.data.ptr);
+        SetSocketReady(
+            pnode,
+            event.events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR),
+            event.events & EPOLLOUT);
+    }
+
+    return true;
+}
+#else
+bool CConnman::SocketEvents() {
     //
     // Find which sockets have data to receive
     //
     struct timeval timeout;
     timeout.tv_sec = 0;
     // Frequency to poll pnode->vSend
-    timeout.tv_usec = 50000;
+    timeout.tv_usec = SOCKET_EVENTS_TIMEOUT_MS * 1000;
 
     fd_set fdsetRecv;
     fd_set fdsetSend;
@@ -1236,7 +1395,7 @@ void CConnman::SocketHandler() {
     int nSelect = select(have_fds ? hSocketMax + 1 : 0, &fdsetRecv, &fdsetSend,
                          &fdsetError, &timeout);
     if (interruptNet) {
-        return;
+        return false;
     }
 
     if (nSelect == SOCKET_ERROR) {
@@ -1251,7 +1410,7 @@ void CConnman::SocketHandler() {
         FD_ZERO(&fdsetError);
         if (!interruptNet.sleep_for(
                 std::chrono::milliseconds(timeout.tv_usec / 1000))) {
-            return;
+            return false;
         }
     }
 
@@ -1265,112 +1424,189 @@ void CConnman::SocketHandler() {
         }
     }
 
+    LOCK(cs_vNodes);
+    for (CNode *pnode : vNodes) {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket == INVALID_SOCKET) {
+            continue;
+        }
+        SetSocketReady(pnode,
+                       FD_ISSET(pnode->hSocket, &fdsetRecv) ||
+                           FD_ISSET(pnode->hSocket, &fdsetError),
+                       FD_ISSET(pnode->hSocket, &fdsetSend));
+    }
+
+    return true;
+}
+#endif
+
+void CConnman::SetSocketReady(CNode *pnode, bool fRecv, bool fSend) {
+    if (!fRecv && !fSend) {
+        return;
+    }
+    if (!pnode->fSocketRecvReady && !pnode->fSocketSendReady) {
+        pnode->AddRef();
+        vSocketReadyNodes.push_back(pnode);
+    }
+    pnode->fSocketRecvReady |= fRecv;
+    pnode->fSocketSendReady |= fSend;
+}
+
+void CConnman::ServiceNodeSocket(CNode *pnode) {
     //
-    // Service each socket
+    // Receive
     //
-    std::vector<CNode *> vNodesCopy;
+    bool recvSet = pnode->fSocketRecvReady;
+    bool sendSet = pnode->fSocketSendReady;
+    pnode->fSocketSendReady = false;
     {
-        LOCK(cs_vNodes);
-        vNodesCopy = vNodes;
-        for (CNode *pnode : vNodesCopy) {
-            pnode->AddRef();
-        }
-    }
-    for (CNode *pnode : vNodesCopy) {
-        if (interruptNet) {
+        LOCK(pnode->cs_hSocket);
+        if (pnode->hSocket == INVALID_SOCKET) {
+            pnode->fSocketRecvReady = false;
             return;
         }
-
-        //
-        // Receive
-        //
-        bool recvSet = false;
-        bool sendSet = false;
-        bool errorSet = false;
+    }
+    // Drain the send buffer before receiving more, and don't receive when the
+    // receive buffer is full. The socket stays flagged as readable until it is
+    // drained.
+    if (recvSet) {
+        LOCK(pnode->cs_vSend);
+        recvSet = !pnode->fPauseRecv && pnode->vSendMsg.empty();
+    }
+    if (recvSet) {
+        // typical socket buffer is 8K-64K
+        char pchBuf[0x10000];
+        int32_t nBytes = 0;
         {
             LOCK(pnode->cs_hSocket);
             if (pnode->hSocket == INVALID_SOCKET) {
-                continue;
+                pnode->fSocketRecvReady = false;
+                return;
             }
-            recvSet = FD_ISSET(pnode->hSocket, &fdsetRecv);
-            sendSet = FD_ISSET(pnode->hSocket, &fdsetSend);
-            errorSet = FD_ISSET(pnode->hSocket, &fdsetError);
-        }
-        if (recvSet || errorSet) {
-            // typical socket buffer is 8K-64K
-            char pchBuf[0x10000];
-            int32_t nBytes = 0;
-            {
-                LOCK(pnode->cs_hSocket);
-                if (pnode->hSocket == INVALID_SOCKET) {
-                    continue;
-                }
-                nBytes =
-                    recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+            nBytes =
+                recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+        }
+        if (nBytes < int32_t(sizeof(pchBuf))) {
+            // The socket has been drained, or is in error.
+            pnode->fSocketRecvReady = false;
+        }
+        if (nBytes > 0) {
+            bool notify = false;
+            if (!pnode->ReceiveMsgBytes(*config, pchBuf, nBytes, notify)) {
+                pnode->CloseSocketDisconnect();
             }
-            if (nBytes > 0) {
-                bool notify = false;
-                if (!pnode->ReceiveMsgBytes(*config, pchBuf, nBytes, notify)) {
-                    pnode->CloseSocketDisconnect();
-                }
-                RecordBytesRecv(nBytes);
-                if (notify) {
-                    size_t nSizeAdded = 0;
-                    auto it(pnode->vRecvMsg.begin());
-                    for (; it != pnode->vRecvMsg.end(); ++it) {
-                        if (!it->complete()) {
-                            break;
-                        }
-                        nSizeAdded +=
-                            it->vRecv.size() + CMessageHeader::HEADER_SIZE;
-                    }
-                    {
-                        LOCK(pnode->cs_vProcessMsg);
-                        pnode->vProcessMsg.splice(pnode->vProcessMsg.end(),
-                                                  pnode->vRecvMsg,
-                                                  pnode->vRecvMsg.begin(), it);
-                        pnode->nProcessQueueSize += nSizeAdded;
-                        pnode->fPauseRecv =
-                            pnode->nProcessQueueSize > nReceiveFloodSize;
+            RecordBytesRecv(nBytes);
+            if (notify) {
+                size_t nSizeAdded = 0;
+                auto it(pnode->vRecvMsg.begin());
+                for (; it != pnode->vRecvMsg.end(); ++it) {
+                    if (!it->complete()) {
+                        break;
                     }
-                    WakeMessageHandler();
+                    nSizeAdded +=
+                        it->vRecv.size() + CMessageHeader::HEADER_SIZE;
+                }
+                {
+                    LOCK(pnode->cs_vProcessMsg);
+                    pnode->vProcessMsg.splice(pnode->vProcessMsg.end(),
+                                              pnode->vRecvMsg,
+                                              pnode->vRecvMsg.begin(), it);
+                    pnode->nProcessQueueSize += nSizeAdded;
+                    pnode->fPauseRecv =
+                        pnode->nProcessQueueSize > nReceiveFloodSize;
                 }
-            } else if (nBytes == 0) {
-                // socket closed gracefully
+                WakeMessageHandler(pnode);
+            }
+        } else if (nBytes == 0) {
+            // socket closed gracefully
+            if (!pnode->fDisconnect) {
+                LogPrint(BCLog::NET, "socket closed\n");
+            }
+            pnode->CloseSocketDisconnect();
+        } else if (nBytes < 0) {
+            // error
+            int nErr = WSAGetLastError();
+            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE &&
+                nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
                 if (!pnode->fDisconnect) {
-                    LogPrint(BCLog::NET, "socket closed\n");
+                    LogPrintf("socket recv error %s\n",
+                              NetworkErrorString(nErr));
                 }
                 pnode->CloseSocketDisconnect();
-            } else if (nBytes < 0) {
-                // error
-                int nErr = WSAGetLastError();
-                if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE &&
-                    nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
-                    if (!pnode->fDisconnect) {
-                        LogPrintf("socket recv error %s\n",
-                                  NetworkErrorString(nErr));
-                    }
-                    pnode->CloseSocketDisconnect();
-                }
             }
         }
+    }
 
-        //
-        // Send
-        //
-        if (sendSet) {
-            LOCK(pnode->cs_vSend);
-            size_t nBytes = SocketSendData(pnode);
-            if (nBytes) {
-                RecordBytesSent(nBytes);
-            }
+    //
+    // Send
+    //
+    if (sendSet) {
+        LOCK(pnode->cs_vSend);
+        size_t nBytes = SocketSendData(pnode);
+        if (nBytes) {
+            RecordBytesSent(nBytes);
         }
+#ifdef USE_EPOLL
+        UpdateSendReadiness(pnode);
+#endif
+    }
+
+}
+
+void CConnman::SocketHandler() {
+    if (!SocketEvents()) {
+        return;
+    }
 
-        InactivityCheck(pnode);
+    //
+    // Service each socket
+    //
+    std::vector<CNode *> vNodesReady;
+    vNodesReady.swap(vSocketReadyNodes);
+    std::vector<CNode *> vNodesDone;
+    for (CNode *pnode : vNodesReady) {
+        if (!interruptNet) {
+            ServiceNodeSocket(pnode);
+        }
+        // Nodes that are still ready keep their reference.
+        if (pnode->fSocketRecvReady || pnode->fSocketSendReady) {
+            vSocketReadyNodes.push_back(pnode);
+        } else {
+            vNodesDone.push_back(pnode);
+        }
     }
+
+    //
+    // Check for inactive peers. This is measured in seconds, so there is no
+    // point in doing it more often.
+    //
+    const int64_t nNow = GetSystemTimeInSeconds();
+    if (nNow != nLastInactivityCheck) {
+        nLastInactivityCheck = nNow;
+        std::vector<CNode *> vNodesCopy;
+        {
+            LOCK(cs_vNodes);
+            vNodesCopy = vNodes;
+            for (CNode *pnode : vNodesCopy) {
+                pnode->AddRef();
+            }
+        }
+        for (CNode *pnode : vNodesCopy) {
+            {
+                LOCK(pnode->cs_hSocket);
+                if (pnode->hSocket == INVALID_SOCKET) {
+                    continue;
+                }
+            }
+            InactivityCheck(pnode);
+        }
+        vNodesDone.insert(vNodesDone.end(), vNodesCopy.begin(),
+                          vNodesCopy.end());
+    }
+
     {
         LOCK(cs_vNodes);
-        for (CNode *pnode : vNodesCopy) {
+        for (CNode *pnode : vNodesDone) {
             pnode->Release();
         }
     }
@@ -1387,9 +1623,23 @@ void CConnman::ThreadSocketHandler() {
 void CConnman::WakeMessageHandler() {
     {
         std::lock_guard<std::mutex> lock(mutexMsgProc);
-        fMsgProcWake = true;
+        vMsgProcWake.assign(vMsgProcWake.size(), true);
     }
-    condMsgProc.notify_one();
+    condMsgProc.notify_all();
+}
+
+void CConnman::WakeMessageHandler(const CNode *pnode) {
+    {
+        std::lock_guard<std::mutex> lock(mutexMsgProc);
+        vMsgProcWake[GetMessageHandler(pnode)] = true;
+    }
+    // All the handler threads wait on the same condition variable, the ones
+    // which have not been woken up go back to sleep.
+    condMsgProc.notify_all();
+}
+
+int CConnman::GetMessageHandler(const CNode *pnode) const {
+    return pnode->GetId() % nMsgHandlerThreads;
 }
 
 #ifdef USE_UPNP
@@ -1969,14 +2219,19 @@ void CConnman::OpenNetworkConnection(const CAddress &addrConnect,
     }
 }
 
-void CConnman::ThreadMessageHandler() {
+void CConnman::ThreadMessageHandler(int nHandler) {
+    if (nMsgHandlerThreads > 1) {
+        util::ThreadRename(strprintf("msghand.%i", nHandler));
+    }
+
     while (!flagInterruptMsgProc) {
         std::vector<CNode *> vNodesCopy;
         {
             LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            for (CNode *pnode : vNodesCopy) {
-                pnode->AddRef();
+            for (CNode *pnode : vNodes) {
+                if (GetMessageHandler(pnode) == nHandler) {
+                    vNodesCopy.push_back(pnode->AddRef());
+                }
             }
         }
 
@@ -2015,12 +2270,13 @@ void CConnman::ThreadMessageHandler() {
 
         WAIT_LOCK(mutexMsgProc, lock);
         if (!fMoreWork) {
-            condMsgProc.wait_until(lock,
-                                   std::chrono::steady_clock::now() +
-                                       std::chrono::milliseconds(100),
-                                   [this] { return fMsgProcWake; });
+            condMsgProc.wait_until(
+                lock,
+                std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(100),
+                [this, nHandler] { return vMsgProcWake[nHandler]; });
         }
-        fMsgProcWake = false;
+        vMsgProcWake[nHandler] = false;
     }
 }
 
@@ -2173,6 +2429,14 @@ CConnman::CConnman(const Config &configIn, uint64_t nSeed0In, uint64_t nSeed1In)
     : config(&configIn), nSeed0(nSeed0In), nSeed1(nSeed1In) {
     SetTryNewOutboundPeer(false);
 
+#ifdef USE_EPOLL
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd == -1) {
+        LogPrintf("Failed to create epoll instance: %s\n",
+                  NetworkErrorString(WSAGetLastError()));
+    }
+#endif
+
     Options connOptions;
     Init(connOptions);
 }
@@ -2241,6 +2505,23 @@ bool CConnman::Start(CScheduler &scheduler, const Options &connOptions) {
         return false;
     }
 
+#ifdef USE_EPOLL
+    if (epollfd == -1) {
+        if (clientInterface) {
+            clientInterface->ThreadSafeMessageBox(
+                _("Failed to initialize the network event loop."), "",
+                CClientUIInterface::MSG_ERROR);
+        }
+        return false;
+    }
+    for (ListenSocket &hListenSocket : vhListenSocket) {
+        if (!EpollControl(epollfd, EPOLL_CTL_ADD, hListenSocket.socket,
+                          &hListenSocket, EPOLLIN)) {
+            return false;
+        }
+    }
+#endif
+
     for (const auto &strDest : connOptions.vSeedNodes) {
         AddOneShot(strDest);
     }
@@ -2287,7 +2568,7 @@ bool CConnman::Start(CScheduler &scheduler, const Options &connOptions) {
 
     {
         LOCK(mutexMsgProc);
-        fMsgProcWake = false;
+        vMsgProcWake.assign(nMsgHandlerThreads, false);
     }
 
     // Send and receive from sockets, accept connections
@@ -2330,10 +2611,12 @@ bool CConnman::Start(CScheduler &scheduler, const Options &connOptions) {
     }
 
     // Process messages
-    threadMessageHandler =
-        std::thread(&TraceThread<std::function<void()>>, "msghand",
-                    std::function<void()>(
-                        std::bind(&CConnman::ThreadMessageHandler, this)));
+    for (int i = 0; i < nMsgHandlerThreads; i++) {
+        threadMessageHandlers.emplace_back(
+            &TraceThread<std::function<void()>>, "msghand",
+            std::function<void()>(
+                std::bind(&CConnman::ThreadMessageHandler, this, i)));
+    }
 
     // Dump network addresses
     scheduler.scheduleEvery(
@@ -2382,9 +2665,12 @@ void CConnman::Interrupt() {
 }
 
 void CConnman::Stop() {
-    if (threadMessageHandler.joinable()) {
-        threadMessageHandler.join();
+    for (std::thread &threadMessageHandler : threadMessageHandlers) {
+        if (threadMessageHandler.joinable()) {
+            threadMessageHandler.join();
+        }
     }
+    threadMessageHandlers.clear();
     if (threadOpenConnections.joinable()) {
         threadOpenConnections.join();
     }
@@ -2425,6 +2711,7 @@ void CConnman::Stop() {
     }
     vNodes.clear();
     vNodesDisconnected.clear();
+    vSocketReadyNodes.clear();
     vhListenSocket.clear();
     semOutbound.reset();
     semAddnode.reset();
@@ -2443,6 +2730,11 @@ void CConnman::DeleteNode(CNode *pnode) {
 CConnman::~CConnman() {
     Interrupt();
     Stop();
+#ifdef USE_EPOLL
+    if (epollfd != -1) {
+        close(epollfd);
+    }
+#endif
 }
 
 size_t CConnman::GetAddressCount() const {
@@ -2709,14 +3001,17 @@ bool CConnman::NodeFullyConnected(const CNode *pnode) {
 }
 
 void CConnman::PushMessage(CNode *pnode, CSerializedNetMsg &&msg) {
-    size_t nMessageSize = msg.data.size();
+    size_t nMessageSize = msg.GetData().size();
     size_t nTotalSize = nMessageSize + CMessageHeader::HEADER_SIZE;
     LogPrint(BCLog::NET, "sending %s (%d bytes) peer=%d\n",
              SanitizeString(msg.command.c_str()), nMessageSize, pnode->GetId());
 
     std::vector<uint8_t> serializedHeader;
     serializedHeader.reserve(CMessageHeader::HEADER_SIZE);
-    uint256 hash = Hash(msg.data.data(), msg.data.data() + nMessageSize);
+    // Shared payloads come with their checksum.
+    uint256 hash = msg.payload
+                       ? msg.payload->hash
+                       : Hash(msg.data.data(), msg.data.data() + nMessageSize);
     CMessageHeader hdr(config->GetChainParams().NetMagic(), msg.command.c_str(),
                        nMessageSize);
     memcpy(hdr.pchChecksum, hash.begin(), CMessageHeader::CHECKSUM_SIZE);
@@ -2735,15 +3030,20 @@ void CConnman::PushMessage(CNode *pnode, CSerializedNetMsg &&msg) {
         if (pnode->nSendSize > nSendBufferMaxSize) {
             pnode->fPauseSend = true;
         }
-        pnode->vSendMsg.push_back(std::move(serializedHeader));
-        if (nMessageSize) {
-            pnode->vSendMsg.push_back(std::move(msg.data));
+        pnode->vSendMsg.emplace_back(std::move(serializedHeader));
+        if (nMessageSize && msg.payload) {
+            pnode->vSendMsg.emplace_back(std::move(msg.payload));
+        } else if (nMessageSize) {
+            pnode->vSendMsg.emplace_back(std::move(msg.data));
         }
 
         // If write queue empty, attempt "optimistic write"
         if (optimisticSend == true) {
             nBytesSent = SocketSendData(pnode);
         }
+#ifdef USE_EPOLL
+        UpdateSendReadiness(pnode);
+#endif
     }
     if (nBytesSent) {
         RecordBytesSent(nBytesSent);
@@ -2764,15 +3064,18 @@ bool CConnman::ForNode(NodeId id, std::function<bool(CNode *pnode)> func) {
 
 int64_t CConnman::PoissonNextSendInbound(int64_t now,
                                          int average_interval_seconds) {
-    if (m_next_send_inv_to_incoming < now) {
-        // If this function were called from multiple threads simultaneously
-        // it would be possible that both update the next send variable, and
-        // return a different result to their caller. This is not possible in
-        // practice as only the net processing thread invokes this function.
-        m_next_send_inv_to_incoming =
+    // This is called from all the message handler threads, make sure they
+    // all agree on the next send time.
+    int64_t next = m_next_send_inv_to_incoming;
+    while (next < now) {
+        const int64_t candidate =
             PoissonNextSend(now, average_interval_seconds);
+        if (m_next_send_inv_to_incoming.compare_exchange_weak(next,
+                                                              candidate)) {
+            return candidate;
+        }
     }
-    return m_next_send_inv_to_incoming;
+    return next;
 }
 
 int64_t PoissonNextSend(int64_t now, int average_interval_seconds) {
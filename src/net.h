@@ -87,6 +87,10 @@ static const bool DEFAULT_BLOCKSONLY = false;
 static const bool DEFAULT_FORCEDNSSEED = false;
 static const size_t DEFAULT_MAXRECEIVEBUFFER = 5 * 1000;
 static const size_t DEFAULT_MAXSENDBUFFER = 1 * 1000;
+/** The default number of message handler threads */
+static const int DEFAULT_MSGHANDLER_THREADS = 4;
+/** The maximum number of message handler threads */
+static const int MAX_MSGHANDLER_THREADS = 16;
 
 typedef int64_t NodeId;
 
@@ -100,6 +104,20 @@ struct AddedNodeInfo {
 struct CNodeStats;
 class CClientUIInterface;
 
+/**
+ * An immutable serialized message payload. It can be queued for sending to
+ * many peers without being serialized or copied again, and its checksum is
+ * only computed once.
+ */
+struct CNetMsgPayload {
+    explicit CNetMsgPayload(std::vector<uint8_t> &&dataIn)
+        : data(std::move(dataIn)), hash(Hash(data.begin(), data.end())) {}
+
+    const std::vector<uint8_t> data;
+    const uint256 hash;
+};
+typedef std::shared_ptr<const CNetMsgPayload> CNetMsgPayloadRef;
+
 struct CSerializedNetMsg {
     CSerializedNetMsg() = default;
     CSerializedNetMsg(CSerializedNetMsg &&) = default;
@@ -110,6 +128,33 @@ struct CSerializedNetMsg {
 
     std::vector<uint8_t> data;
     std::string command;
+    //! If set, the payload is sent from this shared buffer and data is unused.
+    CNetMsgPayloadRef payload;
+
+    const std::vector<uint8_t> &GetData() const {
+        return payload ? payload->data : data;
+    }
+};
+
+/**
+ * A buffer in the send queue of a peer, either owned by the queue or shared
+ * with the queues of other peers.
+ */
+class CSendBuffer {
+public:
+    explicit CSendBuffer(std::vector<uint8_t> &&dataIn)
+        : data(std::move(dataIn)) {}
+    explicit CSendBuffer(CNetMsgPayloadRef payloadIn)
+        : payload(std::move(payloadIn)) {}
+
+    const std::vector<uint8_t> &Get() const {
+        return payload ? payload->data : data;
+    }
+    size_t size() const { return Get().size(); }
+
+private:
+    std::vector<uint8_t> data;
+    CNetMsgPayloadRef payload;
 };
 
 class NetEventsInterface;
@@ -134,6 +179,7 @@ public:
         BanMan *m_banman = nullptr;
         unsigned int nSendBufferMaxSize = 0;
         unsigned int nReceiveFloodSize = 0;
+        int nMsgHandlerThreads = 1;
         uint64_t nMaxOutboundTimeframe = 0;
         uint64_t nMaxOutboundLimit = 0;
         std::vector<std::string> vSeedNodes;
@@ -157,6 +203,9 @@ public:
         m_msgproc = connOptions.m_msgproc;
         nSendBufferMaxSize = connOptions.nSendBufferMaxSize;
         nReceiveFloodSize = connOptions.nReceiveFloodSize;
+        nMsgHandlerThreads =
+            std::max(1, std::min(connOptions.nMsgHandlerThreads,
+                                 MAX_MSGHANDLER_THREADS));
         {
             LOCK(cs_totalBytesSent);
             nMaxOutboundTimeframe = connOptions.nMaxOutboundTimeframe;
@@ -295,7 +344,10 @@ public:
 
     unsigned int GetReceiveFloodSize() const;
 
+    /** Wake up all the message handler threads. */
     void WakeMessageHandler();
+    /** Wake up the message handler thread in charge of pnode. */
+    void WakeMessageHandler(const CNode *pnode);
 
     /**
      * Attempts to obfuscate tx time through exponentially distributed emitting.
@@ -322,11 +374,26 @@ private:
     void AddOneShot(const std::string &strDest);
     void ProcessOneShot();
     void ThreadOpenConnections(std::vector<std::string> connect);
-    void ThreadMessageHandler();
+    /**
+     * Process the messages of the peers assigned to message handler thread
+     * nHandler. Each peer is handled by a single thread, so its messages are
+     * processed in order.
+     */
+    void ThreadMessageHandler(int nHandler);
+    int GetMessageHandler(const CNode *pnode) const;
     void AcceptConnection(const ListenSocket &hListenSocket);
     void DisconnectNodes();
     void NotifyNumConnectionsChanged();
     void InactivityCheck(CNode *pnode);
+    /**
+     * Wait for socket events, accept new connections and flag the nodes
+     * whose sockets are ready. Returns false if interrupted.
+     */
+    bool SocketEvents();
+    /** Flag the node socket as ready, and queue the node for service. */
+    void SetSocketReady(CNode *pnode, bool fRecv, bool fSend);
+    /** Receive from and send to a node socket, as flagged ready. */
+    void ServiceNodeSocket(CNode *pnode);
     void SocketHandler();
     void ThreadSocketHandler();
     void ThreadDNSAddressSeed();
@@ -348,6 +415,13 @@ private:
     NodeId GetNewNodeId();
 
     size_t SocketSendData(CNode *pnode) const;
+#ifdef USE_EPOLL
+    /** Register the node socket with epoll. */
+    void RegisterNodeSocket(CNode *pnode);
+    /** Only watch for send readiness when there is something to send. */
+    void UpdateSendReadiness(CNode *pnode)
+        EXCLUSIVE_LOCKS_REQUIRED(pnode->cs_vSend);
+#endif
     void DumpAddresses();
 
     // Network stats
@@ -388,6 +462,10 @@ private:
     CCriticalSection cs_vAddedNodes;
     std::vector<CNode *> vNodes;
     std::list<CNode *> vNodesDisconnected;
+    //! Nodes whose socket is flagged ready, each holding a reference. Only
+    //! used by the socket handler thread.
+    std::vector<CNode *> vSocketReadyNodes;
+    int64_t nLastInactivityCheck{0};
     mutable CCriticalSection cs_vNodes;
     std::atomic<NodeId> nLastNodeId{0};
     unsigned int nPrevNodeCount{0};
@@ -409,20 +487,26 @@ private:
     /** SipHasher seeds for deterministic randomness */
     const uint64_t nSeed0, nSeed1;
 
-    /** flag for waking the message processor. */
-    bool fMsgProcWake;
+    int nMsgHandlerThreads{1};
 
     std::condition_variable condMsgProc;
     Mutex mutexMsgProc;
+    /** flags for waking the message processor threads. */
+    std::vector<bool> vMsgProcWake GUARDED_BY(mutexMsgProc){false};
     std::atomic<bool> flagInterruptMsgProc{false};
 
     CThreadInterrupt interruptNet;
 
+#ifdef USE_EPOLL
+    //! The epoll instance all the sockets are registered with.
+    int epollfd{-1};
+#endif
+
     std::thread threadDNSAddressSeed;
     std::thread threadSocketHandler;
     std::thread threadOpenAddedConnections;
     std::thread threadOpenConnections;
-    std::thread threadMessageHandler;
+    std::vector<std::thread> threadMessageHandlers;
 
     /**
      * Flag for deciding to connect to an extra outbound peer, in excess of
@@ -622,7 +706,7 @@ public:
     // Offset inside the first vSendMsg already sent.
     size_t nSendOffset{0};
     uint64_t nSendBytes GUARDED_BY(cs_vSend){0};
-    std::deque<std::vector<uint8_t>> vSendMsg GUARDED_BY(cs_vSend);
+    std::deque<CSendBuffer> vSendMsg GUARDED_BY(cs_vSend);
     CCriticalSection cs_vSend;
     CCriticalSection cs_hSocket;
     CCriticalSection cs_vRecv;
@@ -686,6 +770,18 @@ public:
     std::atomic_bool fPauseRecv{false};
     std::atomic_bool fPauseSend{false};
 
+    // Socket readiness, only used by the socket handler thread. With epoll,
+    // readability is only reported when new data arrives, so fSocketRecvReady
+    // stays set until the socket has been drained. The node is queued for
+    // service as long as either flag is set.
+    bool fSocketRecvReady{false};
+    bool fSocketSendReady{false};
+#ifdef USE_EPOLL
+    // Whether the socket is registered for send readiness, which is only the
+    // case when vSendMsg is not empty.
+    bool fSocketSendArmed GUARDED_BY(cs_vSend){false};
+#endif
+
 protected:
     mapMsgCmdSize mapSendBytesPerMsgCmd;
     mapMsgCmdSize mapRecvBytesPerMsgCmd GUARDED_BY(cs_vRecv);
@@ -695,8 +791,10 @@ public:
     std::atomic<int> nStartingHeight{-1};
 
     // flood relay
-    std::vector<CAddress> vAddrToSend;
-    CRollingBloomFilter addrKnown;
+    // Addresses are relayed from other peers' message handler threads.
+    CCriticalSection cs_addrSend;
+    std::vector<CAddress> vAddrToSend GUARDED_BY(cs_addrSend);
+    CRollingBloomFilter addrKnown GUARDED_BY(cs_addrSend);
     bool fGetAddr{false};
     std::set<uint256> setKnown;
     int64_t nNextAddrSend GUARDED_BY(cs_sendProcessing){0};
@@ -799,6 +897,7 @@ public:
     void Release() { nRefCount--; }
 
     void AddAddressKnown(const CAddress &_addr) {
+        LOCK(cs_addrSend);
         addrKnown.insert(_addr.GetKey());
     }
 
@@ -806,6 +905,7 @@ public:
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_addrSend);
         if (_addr.IsValid() && !addrKnown.contains(_addr.GetKey())) {
             if (vAddrToSend.size() >= MAX_ADDR_TO_SEND) {
                 vAddrToSend[insecure_rand.randrange(vAddrToSend.size())] =
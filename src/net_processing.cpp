@@ -29,6 +29,7 @@
 #include <scheduler.h>
 #include <tinyformat.h>
 #include <txmempool.h>
+#include <txorphanpool.h>
 #include <ui_interface.h>
 #include <util/moneystr.h>
 #include <util/strencodings.h>
@@ -121,15 +122,15 @@ static const unsigned int MAX_GETDATA_SZ = 1000;
 /// How many non standard orphan do we consider from a node before ignoring it.
 static constexpr uint32_t MAX_NON_STANDARD_ORPHAN_PER_NODE = 5;
 
-struct COrphanTx {
-    // When modifying, adapt the copy of this definition in tests/DoS_tests.
-    CTransactionRef tx;
-    NodeId fromPeer;
-    int64_t nTimeExpire;
-};
-
 CCriticalSection g_cs_orphans;
-std::map<uint256, COrphanTx> mapOrphanTransactions GUARDED_BY(g_cs_orphans);
+CTxOrphanPool g_orphanpool GUARDED_BY(g_cs_orphans);
+/**
+ * Outputs created by recently connected blocks which are spent by orphans.
+ * These orphans are reconsidered in batches by the message handler.
+ */
+std::deque<COutPoint> g_orphan_work_queue GUARDED_BY(g_cs_orphans);
+
+size_t nMaxOrphanTxBytes = DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE * 1000000;
 
 void EraseOrphansFor(NodeId peer);
 
@@ -227,8 +228,11 @@ int g_outbound_peers_with_protect_from_disconnect GUARDED_BY(cs_main) = 0;
 /** When our tip was last updated. */
 std::atomic<int64_t> g_last_tip_update(0);
 
-/** Relay map. */
-typedef std::map<uint256, CTransactionRef> MapRelay;
+/**
+ * Relay map. The transactions are serialized once and shared by all the peers
+ * requesting them.
+ */
+typedef std::map<uint256, CNetMsgPayloadRef> MapRelay;
 MapRelay mapRelay GUARDED_BY(cs_main);
 /**
  * Expiration-time ordered list of (expire time, relay map entry) pairs,
@@ -240,18 +244,15 @@ std::deque<std::pair<int64_t, MapRelay::iterator>>
 // Used only to inform the wallet of when we last received a block
 std::atomic<int64_t> nTimeBestReceived(0);
 
-struct IteratorComparator {
-    template <typename I> bool operator()(const I &a, const I &b) const {
-        return &(*a) < &(*b);
-    }
-};
-std::map<COutPoint,
-         std::set<std::map<uint256, COrphanTx>::iterator, IteratorComparator>>
-    mapOrphanTransactionsByPrev GUARDED_BY(g_cs_orphans);
-
 static size_t vExtraTxnForCompactIt GUARDED_BY(g_cs_orphans) = 0;
 static std::vector<std::pair<TxHash, CTransactionRef>>
     vExtraTxnForCompact GUARDED_BY(g_cs_orphans);
+
+// Latency of the processed messages, per command. Unknown commands are
+// accounted together so that peers cannot grow the map.
+static Mutex cs_msg_latency;
+static std::map<std::string, CMessageLatencyStats>
+    mapMsgLatency GUARDED_BY(cs_msg_latency);
 } // namespace
 
 namespace {
@@ -997,9 +998,34 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
     return true;
 }
 
+static void RecordMessageLatency(const std::string &strCommand,
+                                 int64_t nTimeReceived, int64_t nTimeStart,
+                                 int64_t nTimeEnd) {
+    static const std::string NET_MESSAGE_COMMAND_OTHER = "*other*";
+    const std::vector<std::string> &allMessageTypes = getAllNetMessageTypes();
+    const bool fKnown =
+        std::find(allMessageTypes.begin(), allMessageTypes.end(),
+                  strCommand) != allMessageTypes.end();
+
+    LOCK(cs_msg_latency);
+    CMessageLatencyStats &stats =
+        mapMsgLatency[fKnown ? strCommand : NET_MESSAGE_COMMAND_OTHER];
+    const int64_t nLatency = nTimeEnd - nTimeReceived;
+    stats.nCount++;
+    stats.nTotalLatency += nLatency;
+    stats.nMaxLatency = std::max(stats.nMaxLatency, nLatency);
+    stats.nTotalProcessingTime += nTimeEnd - nTimeStart;
+}
+
+void GetMessageLatencyStats(
+    std::map<std::string, CMessageLatencyStats> &mapStats) {
+    LOCK(cs_msg_latency);
+    mapStats = mapMsgLatency;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
-// mapOrphanTransactions
+// g_orphanpool
 //
 
 static void AddToCompactExtraTransactions(const CTransactionRef &tx)
@@ -1021,120 +1047,37 @@ static void AddToCompactExtraTransactions(const CTransactionRef &tx)
 
 bool AddOrphanTx(const CTransactionRef &tx, NodeId peer)
     EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans) {
-    const uint256 &txid = tx->GetId();
-    if (mapOrphanTransactions.count(txid)) {
+    if (!g_orphanpool.AddTx(tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME)) {
         return false;
     }
 
-    // Ignore big transactions, to avoid a send-big-orphans memory exhaustion
-    // attack. If a peer has a legitimate large transaction with a missing
-    // parent then we assume it will rebroadcast it later, after the parent
-    // transaction(s) have been mined or received.
-    // 100 orphans, each of which is at most 99,999 bytes big is at most 10
-    // megabytes of orphans and somewhat more byprev index (in the worst case):
-    unsigned int sz = tx->GetTotalSize();
-    if (sz >= MAX_STANDARD_TX_SIZE) {
-        LogPrint(BCLog::MEMPOOL,
-                 "ignoring large orphan tx (size: %u, hash: %s)\n", sz,
-                 txid.ToString());
-        return false;
-    }
-
-    auto ret = mapOrphanTransactions.emplace(
-        txid, COrphanTx{tx, peer, GetTime() + ORPHAN_TX_EXPIRE_TIME});
-    assert(ret.second);
-    for (const CTxIn &txin : tx->vin) {
-        mapOrphanTransactionsByPrev[txin.prevout].insert(ret.first);
-    }
-
     AddToCompactExtraTransactions(tx);
-
-    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u outsz %u)\n",
-             txid.ToString(), mapOrphanTransactions.size(),
-             mapOrphanTransactionsByPrev.size());
     return true;
 }
 
-static int EraseOrphanTx(uint256 hash) EXCLUSIVE_LOCKS_REQUIRED(g_cs_orphans) {
-    std::map<uint256, COrphanTx>::iterator it =
-        mapOrphanTransactions.find(hash);
-    if (it == mapOrphanTransactions.end()) {
-        return 0;
-    }
-    for (const CTxIn &txin : it->second.tx->vin) {
-        auto itPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
-        if (itPrev == mapOrphanTransactionsByPrev.end()) {
-            continue;
-        }
-        itPrev->second.erase(it);
-        if (itPrev->second.empty()) {
-            mapOrphanTransactionsByPrev.erase(itPrev);
-        }
-    }
-    mapOrphanTransactions.erase(it);
-    return 1;
-}
-
 void EraseOrphansFor(NodeId peer) {
     LOCK(g_cs_orphans);
-    int nErased = 0;
-    std::map<uint256, COrphanTx>::iterator iter = mapOrphanTransactions.begin();
-    while (iter != mapOrphanTransactions.end()) {
-        // Increment to avoid iterator becoming invalid.
-        std::map<uint256, COrphanTx>::iterator maybeErase = iter++;
-        if (maybeErase->second.fromPeer == peer) {
-            nErased += EraseOrphanTx(maybeErase->second.tx->GetId());
-        }
-    }
-    if (nErased > 0) {
-        LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx from peer=%d\n", nErased,
-                 peer);
-    }
+    g_orphanpool.EraseForPeer(peer);
 }
 
-unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans) {
+unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans,
+                               size_t nMaxOrphanBytes) {
     LOCK(g_cs_orphans);
 
-    unsigned int nEvicted = 0;
     static int64_t nNextSweep;
     int64_t nNow = GetTime();
     if (nNextSweep <= nNow) {
         // Sweep out expired orphan pool entries:
-        int nErased = 0;
         int64_t nMinExpTime =
             nNow + ORPHAN_TX_EXPIRE_TIME - ORPHAN_TX_EXPIRE_INTERVAL;
-        std::map<uint256, COrphanTx>::iterator iter =
-            mapOrphanTransactions.begin();
-        while (iter != mapOrphanTransactions.end()) {
-            std::map<uint256, COrphanTx>::iterator maybeErase = iter++;
-            if (maybeErase->second.nTimeExpire <= nNow) {
-                nErased += EraseOrphanTx(maybeErase->second.tx->GetId());
-            } else {
-                nMinExpTime =
-                    std::min(maybeErase->second.nTimeExpire, nMinExpTime);
-            }
-        }
+        g_orphanpool.EraseExpired(nNow, nMinExpTime);
         // Sweep again 5 minutes after the next entry that expires in order to
         // batch the linear scan.
         nNextSweep = nMinExpTime + ORPHAN_TX_EXPIRE_INTERVAL;
-        if (nErased > 0) {
-            LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx due to expiration\n",
-                     nErased);
-        }
     }
+
     FastRandomContext rng;
-    while (mapOrphanTransactions.size() > nMaxOrphans) {
-        // Evict a random orphan:
-        uint256 randomhash = rng.rand256();
-        std::map<uint256, COrphanTx>::iterator it =
-            mapOrphanTransactions.lower_bound(randomhash);
-        if (it == mapOrphanTransactions.end()) {
-            it = mapOrphanTransactions.begin();
-        }
-        EraseOrphanTx(it->first);
-        ++nEvicted;
-    }
-    return nEvicted;
+    return g_orphanpool.LimitSize(nMaxOrphans, nMaxOrphanBytes, rng);
 }
 
 /**
@@ -1223,45 +1166,23 @@ PeerLogicValidation::PeerLogicValidation(CConnman *connmanIn, BanMan *banman,
 }
 
 /**
- * Evict orphan txn pool entries (EraseOrphanTx) based on a newly connected
- * block. Also save the time of the last tip update.
+ * Evict orphan txn pool entries based on a newly connected block and queue the
+ * orphans spending its outputs for reprocessing. Also save the time of the
+ * last tip update.
  */
 void PeerLogicValidation::BlockConnected(
     const std::shared_ptr<const CBlock> &pblock, const CBlockIndex *pindex,
     const std::vector<CTransactionRef> &vtxConflicted) {
     LOCK(g_cs_orphans);
 
-    std::vector<uint256> vOrphanErase;
-
-    for (const CTransactionRef &ptx : pblock->vtx) {
-        const CTransaction &tx = *ptx;
-
-        // Which orphan pool entries must we evict?
-        for (const auto &txin : tx.vin) {
-            auto itByPrev = mapOrphanTransactionsByPrev.find(txin.prevout);
-            if (itByPrev == mapOrphanTransactionsByPrev.end()) {
-                continue;
-            }
-
-            for (auto mi = itByPrev->second.begin();
-                 mi != itByPrev->second.end(); ++mi) {
-                const CTransaction &orphanTx = *(*mi)->second.tx;
-                const uint256 &orphanHash = orphanTx.GetHash();
-                vOrphanErase.push_back(orphanHash);
-            }
-        }
-    }
+    g_orphanpool.EraseForBlock(*pblock);
 
-    // Erase orphan transactions included or precluded by this block
-    if (vOrphanErase.size()) {
-        int nErased = 0;
-        for (const uint256 &orphanId : vOrphanErase) {
-            nErased += EraseOrphanTx(orphanId);
-        }
-        LogPrint(BCLog::MEMPOOL,
-                 "Erased %d orphan tx included or conflicted by block\n",
-                 nErased);
-    }
+    // Orphans spending the outputs of this block may now be accepted, queue
+    // them for reprocessing.
+    std::vector<COutPoint> vOutpoints;
+    g_orphanpool.GetSpentOutputs(pblock->vtx, vOutpoints);
+    g_orphan_work_queue.insert(g_orphan_work_queue.end(), vOutpoints.begin(),
+                               vOutpoints.end());
 
     g_last_tip_update = GetTime();
 }
@@ -1274,6 +1195,12 @@ static std::shared_ptr<const CBlock>
 static std::shared_ptr<const CBlockHeaderAndShortTxIDs>
     most_recent_compact_block GUARDED_BY(cs_most_recent_block);
 static uint256 most_recent_block_hash GUARDED_BY(cs_most_recent_block);
+// Serialized forms of the above, shared by all the peers they are sent to. The
+// block itself is only serialized once a peer requests it.
+static CNetMsgPayloadRef
+    most_recent_compact_block_payload GUARDED_BY(cs_most_recent_block);
+static CNetMsgPayloadRef
+    most_recent_block_payload GUARDED_BY(cs_most_recent_block);
 
 /**
  * Maintain state about the best-seen block and fast-announce a compact block
@@ -1284,6 +1211,8 @@ void PeerLogicValidation::NewPoWValidBlock(
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> pcmpctblock =
         std::make_shared<const CBlockHeaderAndShortTxIDs>(*pblock);
     const CNetMsgMaker msgMaker(PROTOCOL_VERSION);
+    const CNetMsgPayloadRef cmpctblockPayload =
+        msgMaker.MakePayload(*pcmpctblock);
 
     LOCK(cs_main);
 
@@ -1300,13 +1229,14 @@ void PeerLogicValidation::NewPoWValidBlock(
         most_recent_block_hash = hashBlock;
         most_recent_block = pblock;
         most_recent_compact_block = pcmpctblock;
+        most_recent_compact_block_payload = cmpctblockPayload;
+        most_recent_block_payload.reset();
     }
 
-    connman->ForEachNode([this, &pcmpctblock, pindex, &msgMaker,
+    connman->ForEachNode([this, &cmpctblockPayload, pindex, &msgMaker,
                           &hashBlock](CNode *pnode) {
         AssertLockHeld(cs_main);
 
-        // TODO: Avoid the repeated-serialization here
         if (pnode->nVersion < INVALID_CB_NO_BAN_VERSION || pnode->fDisconnect) {
             return;
         }
@@ -1320,7 +1250,7 @@ void PeerLogicValidation::NewPoWValidBlock(
                      "PeerLogicValidation::NewPoWValidBlock",
                      hashBlock.ToString(), pnode->GetId());
             connman->PushMessage(
-                pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, *pcmpctblock));
+                pnode, msgMaker.Make(NetMsgType::CMPCTBLOCK, cmpctblockPayload));
             state.pindexBestHeaderSent = pindex;
         }
     });
@@ -1436,7 +1366,7 @@ static bool AlreadyHave(const CInv &inv) EXCLUSIVE_LOCKS_REQUIRED(cs_main) {
 
             {
                 LOCK(g_cs_orphans);
-                if (mapOrphanTransactions.count(inv.hash)) {
+                if (g_orphanpool.HaveTx(TxId(inv.hash))) {
                     return true;
                 }
             }
@@ -1507,6 +1437,30 @@ static void RelayAddress(const CAddress &addr, bool fReachable,
     connman->ForEachNodeThen(std::move(sortfunc), std::move(pushfunc));
 }
 
+/**
+ * Get the serialized form of the most recent block, serializing it if it was
+ * not yet.
+ */
+static CNetMsgPayloadRef
+GetMostRecentBlockPayload(const std::shared_ptr<const CBlock> &pblock,
+                          const CNetMsgMaker &msgMaker) {
+    {
+        LOCK(cs_most_recent_block);
+        if (most_recent_block == pblock && most_recent_block_payload) {
+            return most_recent_block_payload;
+        }
+    }
+
+    // Serialize out of the lock, as this can take some time for large blocks.
+    CNetMsgPayloadRef payload = msgMaker.MakePayload(*pblock);
+
+    LOCK(cs_most_recent_block);
+    if (most_recent_block == pblock && !most_recent_block_payload) {
+        most_recent_block_payload = payload;
+    }
+    return payload;
+}
+
 static void ProcessGetBlockData(const Config &config, CNode *pfrom,
                                 const CInv &inv, CConnman *connman,
                                 const std::atomic<bool> &interruptMsgProc) {
@@ -1518,10 +1472,12 @@ static void ProcessGetBlockData(const Config &config, CNode *pfrom,
     bool send = false;
     std::shared_ptr<const CBlock> a_recent_block;
     std::shared_ptr<const CBlockHeaderAndShortTxIDs> a_recent_compact_block;
+    CNetMsgPayloadRef a_recent_compact_block_payload;
     {
         LOCK(cs_most_recent_block);
         a_recent_block = most_recent_block;
         a_recent_compact_block = most_recent_compact_block;
+        a_recent_compact_block_payload = most_recent_compact_block_payload;
     }
 
     bool need_activate_chain = false;
@@ -1549,136 +1505,172 @@ static void ProcessGetBlockData(const Config &config, CNode *pfrom,
         }
     }
 
-    LOCK(cs_main);
-    const CBlockIndex *pindex = LookupBlockIndex(hash);
-    if (pindex) {
-        send = BlockRequestAllowed(pindex, consensusParams);
-        if (!send) {
+    const CBlockIndex *pindex = nullptr;
+    bool fCanSendCompact = false;
+    BlockHash tipHash;
+    {
+        LOCK(cs_main);
+        pindex = LookupBlockIndex(hash);
+        if (pindex) {
+            send = BlockRequestAllowed(pindex, consensusParams);
+            if (!send) {
+                LogPrint(BCLog::NET,
+                         "%s: ignoring request from peer=%i for old "
+                         "block that isn't in the main chain\n",
+                         __func__, pfrom->GetId());
+            }
+        }
+        // Disconnect node in case we have reached the outbound limit for
+        // serving historical blocks.
+        // Never disconnect whitelisted nodes.
+        if (send && connman->OutboundTargetReached(true) &&
+            (((pindexBestHeader != nullptr) &&
+              (pindexBestHeader->GetBlockTime() - pindex->GetBlockTime() >
+               HISTORICAL_BLOCK_AGE)) ||
+             inv.type == MSG_FILTERED_BLOCK) &&
+            !pfrom->fWhitelisted) {
+            LogPrint(
+                BCLog::NET,
+                "historical block serving limit reached, disconnect peer=%d\n",
+                pfrom->GetId());
+
+            // disconnect node
+            pfrom->fDisconnect = true;
+            send = false;
+        }
+        // Avoid leaking prune-height by never sending blocks below the
+        // NODE_NETWORK_LIMITED threshold.
+        // Add two blocks buffer extension for possible races
+        if (send && !pfrom->fWhitelisted &&
+            ((((pfrom->GetLocalServices() & NODE_NETWORK_LIMITED) ==
+               NODE_NETWORK_LIMITED) &&
+              ((pfrom->GetLocalServices() & NODE_NETWORK) != NODE_NETWORK) &&
+              (::ChainActive().Tip()->nHeight - pindex->nHeight >
+               (int)NODE_NETWORK_LIMITED_MIN_BLOCKS + 2)))) {
             LogPrint(BCLog::NET,
-                     "%s: ignoring request from peer=%i for old "
-                     "block that isn't in the main chain\n",
-                     __func__, pfrom->GetId());
+                     "Ignore block request below NODE_NETWORK_LIMITED "
+                     "threshold from peer=%d\n",
+                     pfrom->GetId());
+
+            // disconnect node and prevent it from stalling (would otherwise
+            // wait for the missing block)
+            pfrom->fDisconnect = true;
+            send = false;
         }
-    }
-    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
-    // Disconnect node in case we have reached the outbound limit for serving
-    // historical blocks.
-    // Never disconnect whitelisted nodes.
-    if (send && connman->OutboundTargetReached(true) &&
-        (((pindexBestHeader != nullptr) &&
-          (pindexBestHeader->GetBlockTime() - pindex->GetBlockTime() >
-           HISTORICAL_BLOCK_AGE)) ||
-         inv.type == MSG_FILTERED_BLOCK) &&
-        !pfrom->fWhitelisted) {
-        LogPrint(BCLog::NET,
-                 "historical block serving limit reached, disconnect peer=%d\n",
-                 pfrom->GetId());
+        // Pruned nodes may have deleted the block, so check whether it's
+        // available before trying to send.
+        send = send && pindex->nStatus.hasData();
+        if (send) {
+            // If a peer is asking for old blocks, we're almost guaranteed they
+            // won't have a useful mempool to match against a compact block,
+            // and we don't feel like constructing the object for them, so
+            // instead we respond with the full, non-compact block.
+            fCanSendCompact =
+                CanDirectFetch(consensusParams) &&
+                pindex->nHeight >=
+                    ::ChainActive().Height() - MAX_CMPCTBLOCK_DEPTH;
+            tipHash = ::ChainActive().Tip()->GetBlockHash();
+        }
+    } // release cs_main before reading the block from disk
 
-        // disconnect node
-        pfrom->fDisconnect = true;
-        send = false;
-    }
-    // Avoid leaking prune-height by never sending blocks below the
-    // NODE_NETWORK_LIMITED threshold.
-    // Add two blocks buffer extension for possible races
-    if (send && !pfrom->fWhitelisted &&
-        ((((pfrom->GetLocalServices() & NODE_NETWORK_LIMITED) ==
-           NODE_NETWORK_LIMITED) &&
-          ((pfrom->GetLocalServices() & NODE_NETWORK) != NODE_NETWORK) &&
-          (::ChainActive().Tip()->nHeight - pindex->nHeight >
-           (int)NODE_NETWORK_LIMITED_MIN_BLOCKS + 2)))) {
-        LogPrint(BCLog::NET,
-                 "Ignore block request below NODE_NETWORK_LIMITED "
-                 "threshold from peer=%d\n",
-                 pfrom->GetId());
+    if (!send) {
+        return;
+    }
 
-        // disconnect node and prevent it from stalling (would otherwise wait
-        // for the missing block)
-        pfrom->fDisconnect = true;
-        send = false;
-    }
-    // Pruned nodes may have deleted the block, so check whether it's available
-    // before trying to send.
-    if (send && pindex->nStatus.hasData()) {
-        std::shared_ptr<const CBlock> pblock;
-        if (a_recent_block &&
-            a_recent_block->GetHash() == pindex->GetBlockHash()) {
-            pblock = a_recent_block;
-        } else {
-            // Send block from disk
-            std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
-            if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams)) {
-                assert(!"cannot load block from disk");
-            }
-            pblock = pblockRead;
-        }
-        if (inv.type == MSG_BLOCK) {
-            connman->PushMessage(pfrom,
-                                 msgMaker.Make(NetMsgType::BLOCK, *pblock));
-        } else if (inv.type == MSG_FILTERED_BLOCK) {
-            bool sendMerkleBlock = false;
-            CMerkleBlock merkleBlock;
+    std::shared_ptr<const CBlock> pblock;
+    const bool fRecentBlock =
+        a_recent_block && a_recent_block->GetHash() == pindex->GetBlockHash();
+    if (fRecentBlock) {
+        pblock = a_recent_block;
+    } else {
+        // Send block from disk
+        std::shared_ptr<CBlock> pblockRead = std::make_shared<CBlock>();
+        if (!ReadBlockFromDisk(*pblockRead, pindex, consensusParams)) {
+            // The block may have been pruned since cs_main was released.
             {
-                LOCK(pfrom->cs_filter);
-                if (pfrom->pfilter) {
-                    sendMerkleBlock = true;
-                    merkleBlock = CMerkleBlock(*pblock, *pfrom->pfilter);
+                LOCK(cs_main);
+                if (pindex->nStatus.hasData()) {
+                    assert(!"cannot load block from disk");
                 }
             }
-            if (sendMerkleBlock) {
-                connman->PushMessage(
-                    pfrom, msgMaker.Make(NetMsgType::MERKLEBLOCK, merkleBlock));
-                // CMerkleBlock just contains hashes, so also push any
-                // transactions in the block the client did not see. This avoids
-                // hurting performance by pointlessly requiring a round-trip.
-                // Note that there is currently no way for a node to request any
-                // single transactions we didn't send here - they must either
-                // disconnect and retry or request the full block. Thus, the
-                // protocol spec specified allows for us to provide duplicate
-                // txn here, however we MUST always provide at least what the
-                // remote peer needs.
-                typedef std::pair<size_t, uint256> PairType;
-                for (PairType &pair : merkleBlock.vMatchedTxn) {
-                    connman->PushMessage(
-                        pfrom, msgMaker.Make(NetMsgType::TX,
-                                             *pblock->vtx[pair.first]));
-                }
+            LogPrint(BCLog::NET,
+                     "Block was pruned before it could be read, disconnect "
+                     "peer=%d\n",
+                     pfrom->GetId());
+            pfrom->fDisconnect = true;
+            return;
+        }
+        pblock = pblockRead;
+    }
+
+    const CNetMsgMaker msgMaker(pfrom->GetSendVersion());
+    if (inv.type == MSG_BLOCK && fRecentBlock) {
+        // The most recent block is requested by many peers, serialize it once.
+        connman->PushMessage(
+            pfrom, msgMaker.Make(NetMsgType::BLOCK,
+                                 GetMostRecentBlockPayload(pblock, msgMaker)));
+    } else if (inv.type == MSG_BLOCK) {
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::BLOCK, *pblock));
+    } else if (inv.type == MSG_FILTERED_BLOCK) {
+        bool sendMerkleBlock = false;
+        CMerkleBlock merkleBlock;
+        {
+            LOCK(pfrom->cs_filter);
+            if (pfrom->pfilter) {
+                sendMerkleBlock = true;
+                merkleBlock = CMerkleBlock(*pblock, *pfrom->pfilter);
             }
-            // else
-            // no response
-        } else if (inv.type == MSG_CMPCT_BLOCK) {
-            // If a peer is asking for old blocks, we're almost guaranteed they
-            // won't have a useful mempool to match against a compact block, and
-            // we don't feel like constructing the object for them, so instead
-            // we respond with the full, non-compact block.
-            int nSendFlags = 0;
-            if (CanDirectFetch(consensusParams) &&
-                pindex->nHeight >=
-                    ::ChainActive().Height() - MAX_CMPCTBLOCK_DEPTH) {
-                CBlockHeaderAndShortTxIDs cmpctblock(*pblock);
-                connman->PushMessage(
-                    pfrom, msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK,
-                                         cmpctblock));
-            } else {
+        }
+        if (sendMerkleBlock) {
+            connman->PushMessage(
+                pfrom, msgMaker.Make(NetMsgType::MERKLEBLOCK, merkleBlock));
+            // CMerkleBlock just contains hashes, so also push any transactions
+            // in the block the client did not see. This avoids hurting
+            // performance by pointlessly requiring a round-trip. Note that
+            // there is currently no way for a node to request any single
+            // transactions we didn't send here - they must either disconnect
+            // and retry or request the full block. Thus, the protocol spec
+            // specified allows for us to provide duplicate txn here, however we
+            // MUST always provide at least what the remote peer needs.
+            typedef std::pair<size_t, uint256> PairType;
+            for (PairType &pair : merkleBlock.vMatchedTxn) {
                 connman->PushMessage(
                     pfrom,
-                    msgMaker.Make(nSendFlags, NetMsgType::BLOCK, *pblock));
+                    msgMaker.Make(NetMsgType::TX, *pblock->vtx[pair.first]));
             }
         }
-
-        // Trigger the peer node to send a getblocks request for the next batch
-        // of inventory.
-        if (hash == pfrom->hashContinue) {
-            // Bypass PushInventory, this must send even if redundant, and we
-            // want it right after the last block so they don't wait for other
-            // stuff first.
-            std::vector<CInv> vInv;
-            vInv.push_back(
-                CInv(MSG_BLOCK, ::ChainActive().Tip()->GetBlockHash()));
-            connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::INV, vInv));
-            pfrom->hashContinue = BlockHash();
+        // else
+        // no response
+    } else if (inv.type == MSG_CMPCT_BLOCK) {
+        int nSendFlags = 0;
+        if (fCanSendCompact && a_recent_compact_block &&
+            a_recent_compact_block->header.GetHash() ==
+                pindex->GetBlockHash()) {
+            connman->PushMessage(
+                pfrom, msgMaker.Make(NetMsgType::CMPCTBLOCK,
+                                     a_recent_compact_block_payload));
+        } else if (fCanSendCompact) {
+            CBlockHeaderAndShortTxIDs cmpctblock(*pblock);
+            connman->PushMessage(
+                pfrom,
+                msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK, cmpctblock));
+        } else {
+            connman->PushMessage(
+                pfrom, msgMaker.Make(nSendFlags, NetMsgType::BLOCK, *pblock));
         }
     }
+
+    // Trigger the peer node to send a getblocks request for the next batch of
+    // inventory.
+    if (hash == pfrom->hashContinue) {
+        // Bypass PushInventory, this must send even if redundant, and we want
+        // it right after the last block so they don't wait for other stuff
+        // first.
+        std::vector<CInv> vInv;
+        vInv.push_back(CInv(MSG_BLOCK, tipHash));
+        connman->PushMessage(pfrom, msgMaker.Make(NetMsgType::INV, vInv));
+        pfrom->hashContinue = BlockHash();
+    }
 }
 
 static void ProcessGetData(const Config &config, CNode *pfrom,
@@ -1711,8 +1703,7 @@ static void ProcessGetData(const Config &config, CNode *pfrom,
             int nSendFlags = 0;
             if (mi != mapRelay.end()) {
                 connman->PushMessage(
-                    pfrom,
-                    msgMaker.Make(nSendFlags, NetMsgType::TX, *mi->second));
+                    pfrom, msgMaker.Make(NetMsgType::TX, mi->second));
                 push = true;
             } else if (pfrom->timeLastMempoolReq) {
                 auto txinfo = g_mempool.info(TxId(inv.hash));
@@ -2050,6 +2041,110 @@ static bool ProcessHeadersMessage(const Config &config, CNode *pfrom,
     return true;
 }
 
+/**
+ * Reconsider the orphans spending any of the outpoints in vWorkQueue, and
+ * recursively the orphans spending the outputs of those which get accepted to
+ * the mempool.
+ */
+static void ProcessOrphanTx(const Config &config, CConnman *connman,
+                            std::deque<COutPoint> &vWorkQueue)
+    EXCLUSIVE_LOCKS_REQUIRED(cs_main, g_cs_orphans) {
+    AssertLockHeld(cs_main);
+    AssertLockHeld(g_cs_orphans);
+
+    std::unordered_map<NodeId, uint32_t> rejectCountPerNode;
+    while (!vWorkQueue.empty()) {
+        std::vector<TxId> vOrphans;
+        g_orphanpool.GetChildren(vWorkQueue.front(), vOrphans);
+        vWorkQueue.pop_front();
+        for (const TxId &orphanId : vOrphans) {
+            const CTxOrphanPool::Entry *orphan = g_orphanpool.GetTx(orphanId);
+            if (!orphan) {
+                // Already processed while handling another outpoint.
+                continue;
+            }
+            // Copy what we need, as the orphan may be erased below.
+            const CTransactionRef porphanTx = orphan->tx;
+            const CTransaction &orphanTx = *porphanTx;
+            NodeId fromPeer = orphan->fromPeer;
+            bool fMissingInputs2 = false;
+            // Use a dummy CValidationState so someone can't setup nodes to
+            // counter-DoS based on orphan resolution (that is, feeding people
+            // an invalid transaction based on LegitTxX in order to get anyone
+            // relaying LegitTxX banned)
+            CValidationState stateDummy;
+
+            auto it = rejectCountPerNode.find(fromPeer);
+            if (it != rejectCountPerNode.end() &&
+                it->second > MAX_NON_STANDARD_ORPHAN_PER_NODE) {
+                continue;
+            }
+
+            if (AcceptToMemoryPool(config, g_mempool, stateDummy, porphanTx,
+                                   &fMissingInputs2, false /* bypass_limits */,
+                                   Amount::zero() /* nAbsurdFee */)) {
+                LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n",
+                         orphanId.ToString());
+                RelayTransaction(orphanTx, connman);
+                for (size_t i = 0; i < orphanTx.vout.size(); i++) {
+                    vWorkQueue.emplace_back(orphanId, i);
+                }
+                g_orphanpool.EraseTx(orphanId);
+            } else if (!fMissingInputs2) {
+                int nDos = 0;
+                if (stateDummy.IsInvalid(nDos)) {
+                    rejectCountPerNode[fromPeer]++;
+                    if (nDos > 0) {
+                        // Punish peer that gave us an invalid orphan tx
+                        Misbehaving(fromPeer, nDos, "invalid-orphan-tx");
+                        LogPrint(BCLog::MEMPOOL, "   invalid orphan tx %s\n",
+                                 orphanId.ToString());
+                    }
+                }
+                // Has inputs but not accepted to mempool
+                // Probably non-standard or insufficient fee
+                LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n",
+                         orphanId.ToString());
+                g_orphanpool.EraseTx(orphanId);
+                if (!stateDummy.CorruptionPossible()) {
+                    // Do not use rejection cache for witness transactions or
+                    // witness-stripped transactions, as they can have been
+                    // malleated. See
+                    // https://github.com/bitcoin/bitcoin/issues/8279 for
+                    // details.
+                    assert(recentRejects);
+                    recentRejects->insert(orphanId);
+                }
+            }
+            g_mempool.check(pcoinsTip.get());
+        }
+    }
+}
+
+/**
+ * Reconsider a batch of the orphans whose parents were included in recently
+ * connected blocks.
+ */
+static void ProcessOrphanWorkQueue(const Config &config, CConnman *connman) {
+    std::deque<COutPoint> vWorkQueue;
+    {
+        LOCK(g_cs_orphans);
+        if (g_orphan_work_queue.empty()) {
+            return;
+        }
+
+        const size_t nBatch =
+            std::min(g_orphan_work_queue.size(), ORPHAN_REPROCESS_BATCH_SIZE);
+        vWorkQueue.assign(g_orphan_work_queue.begin(),
+                          g_orphan_work_queue.begin() + nBatch);
+        g_orphan_work_queue.erase(g_orphan_work_queue.begin(),
+                                  g_orphan_work_queue.begin() + nBatch);
+    }
+
+    LOCK2(cs_main, g_cs_orphans);
+    ProcessOrphanTx(config, connman, vWorkQueue);
+}
+
 static bool ProcessMessage(const Config &config, CNode *pfrom,
                            const std::string &strCommand, CDataStream &vRecv,
                            int64_t nTimeReceived, CConnman *connman,
@@ -2780,7 +2875,6 @@ static bool ProcessMessage(const Config &config, CNode *pfrom,
         }
 
         std::deque<COutPoint> vWorkQueue;
-        std::vector<uint256> vEraseQueue;
         CTransactionRef ptx;
         vRecv >> ptx;
         const CTransaction &tx = *ptx;
@@ -2789,7 +2883,10 @@ static bool ProcessMessage(const Config &config, CNode *pfrom,
         CInv inv(MSG_TX, txid);
         pfrom->AddInventoryKnown(inv);
 
-        LOCK2(cs_main, g_cs_orphans);
+        // The orphan pool is only locked when it is used, so the other message
+        // handler threads are not blocked on it while the transaction is
+        // validated.
+        LOCK(cs_main);
 
         bool fMissingInputs = false;
         CValidationState state;
@@ -2819,79 +2916,8 @@ static bool ProcessMessage(const Config &config, CNode *pfrom,
 
             // Recursively process any orphan transactions that depended on this
             // one
-            std::unordered_map<NodeId, uint32_t> rejectCountPerNode;
-            while (!vWorkQueue.empty()) {
-                auto itByPrev =
-                    mapOrphanTransactionsByPrev.find(vWorkQueue.front());
-                vWorkQueue.pop_front();
-                if (itByPrev == mapOrphanTransactionsByPrev.end()) {
-                    continue;
-                }
-                for (auto mi = itByPrev->second.begin();
-                     mi != itByPrev->second.end(); ++mi) {
-                    const CTransactionRef &porphanTx = (*mi)->second.tx;
-                    const CTransaction &orphanTx = *porphanTx;
-                    const TxId &orphanId = orphanTx.GetId();
-                    NodeId fromPeer = (*mi)->second.fromPeer;
-                    bool fMissingInputs2 = false;
-                    // Use a dummy CValidationState so someone can't setup nodes
-                    // to counter-DoS based on orphan resolution (that is,
-                    // feeding people an invalid transaction based on LegitTxX
-                    // in order to get anyone relaying LegitTxX banned)
-                    CValidationState stateDummy;
-
-                    auto it = rejectCountPerNode.find(fromPeer);
-                    if (it != rejectCountPerNode.end() &&
-                        it->second > MAX_NON_STANDARD_ORPHAN_PER_NODE) {
-                        continue;
-                    }
-
-                    if (AcceptToMemoryPool(config, g_mempool, stateDummy,
-                                           porphanTx, &fMissingInputs2,
-                                           false /* bypass_limits */,
-                                           Amount::zero() /* nAbsurdFee */)) {
-                        LogPrint(BCLog::MEMPOOL, "   accepted orphan tx %s\n",
-                                 orphanId.ToString());
-                        RelayTransaction(orphanTx, connman);
-                        for (size_t i = 0; i < orphanTx.vout.size(); i++) {
-                            vWorkQueue.emplace_back(orphanId, i);
-                        }
-                        vEraseQueue.push_back(orphanId);
-                    } else if (!fMissingInputs2) {
-                        int nDos = 0;
-                        if (stateDummy.IsInvalid(nDos)) {
-                            rejectCountPerNode[fromPeer]++;
-                            if (nDos > 0) {
-                                // Punish peer that gave us an invalid orphan tx
-                                Misbehaving(fromPeer, nDos,
-                                            "invalid-orphan-tx");
-                                LogPrint(BCLog::MEMPOOL,
-                                         "   invalid orphan tx %s\n",
-                                         orphanId.ToString());
-                            }
-                        }
-                        // Has inputs but not accepted to mempool
-                        // Probably non-standard or insufficient fee
-                        LogPrint(BCLog::MEMPOOL, "   removed orphan tx %s\n",
-                                 orphanId.ToString());
-                        vEraseQueue.push_back(orphanId);
-                        if (!stateDummy.CorruptionPossible()) {
-                            // Do not use rejection cache for witness
-                            // transactions or witness-stripped transactions, as
-                            // they can have been malleated. See
-                            // https://github.com/bitcoin/bitcoin/issues/8279
-                            // for details.
-                            assert(recentRejects);
-                            recentRejects->insert(orphanId);
-                        }
-                    }
-                    g_mempool.check(pcoinsTip.get());
-                }
-            }
-
-            for (const uint256 &hash : vEraseQueue) {
-                EraseOrphanTx(hash);
-            }
+            LOCK(g_cs_orphans);
+            ProcessOrphanTx(config, connman, vWorkQueue);
         } else if (fMissingInputs) {
             // It may be the case that the orphans parents have all been
             // rejected.
@@ -2914,14 +2940,18 @@ static bool ProcessMessage(const Config &config, CNode *pfrom,
                         RequestTx(State(pfrom->GetId()), _txid, nNow);
                     }
                 }
-                AddOrphanTx(ptx, pfrom->GetId());
+                {
+                    LOCK(g_cs_orphans);
+                    AddOrphanTx(ptx, pfrom->GetId());
+                }
 
-                // DoS prevention: do not allow mapOrphanTransactions to grow
+                // DoS prevention: do not allow g_orphanpool to grow
                 // unbounded
                 unsigned int nMaxOrphanTx = (unsigned int)std::max(
                     int64_t(0), gArgs.GetArg("-maxorphantx",
                                              DEFAULT_MAX_ORPHAN_TRANSACTIONS));
-                unsigned int nEvicted = LimitOrphanTxSize(nMaxOrphanTx);
+                unsigned int nEvicted =
+                    LimitOrphanTxSize(nMaxOrphanTx, nMaxOrphanTxBytes);
                 if (nEvicted > 0) {
                     LogPrint(BCLog::MEMPOOL,
                              "mapOrphan overflow, removed %u tx\n", nEvicted);
@@ -2943,6 +2973,7 @@ static bool ProcessMessage(const Config &config, CNode *pfrom,
                 assert(recentRejects);
                 recentRejects->insert(tx.GetId());
                 if (RecursiveDynamicUsage(*ptx) < 100000) {
+                    LOCK(g_cs_orphans);
                     AddToCompactExtraTransactions(ptx);
                 }
             }
@@ -3510,7 +3541,10 @@ static bool ProcessMessage(const Config &config, CNode *pfrom,
         }
         pfrom->fSentAddr = true;
 
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_addrSend);
+            pfrom->vAddrToSend.clear();
+        }
         std::vector<CAddress> vAddr = connman->GetAddresses();
         FastRandomContext insecure_rand;
         for (const CAddress &addr : vAddr) {
@@ -3783,6 +3817,8 @@ bool PeerLogicValidation::ProcessMessages(const Config &config, CNode *pfrom,
     //
     bool fMoreWork = false;
 
+    ProcessOrphanWorkQueue(config, connman);
+
     if (!pfrom->vRecvGetData.empty()) {
         ProcessGetData(config, pfrom, connman, interruptMsgProc);
     }
@@ -3873,6 +3909,7 @@ bool PeerLogicValidation::ProcessMessages(const Config &config, CNode *pfrom,
 
     // Process message
     bool fRet = false;
+    const int64_t nTimeStart = GetTimeMicros();
     try {
         fRet = ProcessMessage(config, pfrom, strCommand, vRecv, msg.nTime,
                               connman, interruptMsgProc, m_enable_bip61);
@@ -3917,6 +3954,8 @@ bool PeerLogicValidation::ProcessMessages(const Config &config, CNode *pfrom,
         PrintExceptionContinue(nullptr, "ProcessMessages()");
     }
 
+    RecordMessageLatency(strCommand, msg.nTime, nTimeStart, GetTimeMicros());
+
     if (!fRet) {
         LogPrint(BCLog::NET, "%s(%s, %u bytes) FAILED peer=%d\n", __func__,
                  SanitizeString(strCommand), nMessageSize, pfrom->GetId());
@@ -4208,6 +4247,7 @@ bool PeerLogicValidation::SendMessages(const Config &config, CNode *pto,
     if (pto->nNextAddrSend < nNow) {
         pto->nNextAddrSend =
             PoissonNextSend(nNow, AVG_ADDRESS_BROADCAST_INTERVAL);
+        LOCK(pto->cs_addrSend);
         std::vector<CAddress> vAddr;
         vAddr.reserve(pto->vAddrToSend.size());
         for (const CAddress &addr : pto->vAddrToSend) {
@@ -4370,12 +4410,10 @@ bool PeerLogicValidation::SendMessages(const Config &config, CNode *pto,
                 {
                     LOCK(cs_most_recent_block);
                     if (most_recent_block_hash == pBestIndex->GetBlockHash()) {
-                        CBlockHeaderAndShortTxIDs cmpctblock(
-                            *most_recent_block);
                         connman->PushMessage(
                             pto,
-                            msgMaker.Make(nSendFlags, NetMsgType::CMPCTBLOCK,
-                                          cmpctblock));
+                            msgMaker.Make(NetMsgType::CMPCTBLOCK,
+                                          most_recent_compact_block_payload));
                         fGotBlockFromCache = true;
                     }
                 }
@@ -4585,9 +4623,9 @@ bool PeerLogicValidation::SendMessages(const Config &config, CNode *pto,
                         vRelayExpiration.pop_front();
                     }
 
-                    auto ret = mapRelay.insert(
-                        std::make_pair(txid, std::move(txinfo.tx)));
+                    auto ret = mapRelay.emplace(txid, nullptr);
                     if (ret.second) {
+                        ret.first->second = msgMaker.MakePayload(*txinfo.tx);
                         vRelayExpiration.push_back(std::make_pair(
                             nNow + 15 * 60 * 1000000, ret.first));
                     }
@@ -4834,7 +4872,7 @@ public:
     CNetProcessingCleanup() {}
     ~CNetProcessingCleanup() {
         // orphan transactions
-        mapOrphanTransactions.clear();
-        mapOrphanTransactionsByPrev.clear();
+        g_orphanpool.Clear();
+        g_orphan_work_queue.clear();
     }
 } instance_of_cnetprocessingcleanup;
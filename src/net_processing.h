@@ -17,6 +17,16 @@ class Config;
  * memory.
  */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
+/**
+ * Default for -maxorphantxsize, maximum size in megabytes of the orphan
+ * transactions kept in memory.
+ */
+static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS_SIZE = 10;
+/**
+ * Maximum number of outpoints created by a connected block for which spending
+ * orphans are reconsidered in one go.
+ */
+static constexpr size_t ORPHAN_REPROCESS_BATCH_SIZE = 100;
 /**
  * Default number of orphan+recently-replaced txn to keep around for block
  * reconstruction.
@@ -123,8 +133,25 @@ struct CNodeStateStats {
     std::vector<int> vHeightInFlight;
 };
 
+/** Latency statistics of the messages of a given command. */
+struct CMessageLatencyStats {
+    uint64_t nCount = 0;
+    //! Time between the reception of the messages and the end of their
+    //! processing, in microseconds.
+    int64_t nTotalLatency = 0;
+    int64_t nMaxLatency = 0;
+    //! Time spent processing the messages, in microseconds.
+    int64_t nTotalProcessingTime = 0;
+};
+
+/** Maximum size in bytes of the orphan pool, set from -maxorphantxsize. */
+extern size_t nMaxOrphanTxBytes;
+
 /** Get statistics from node state */
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
+/** Get the latency statistics of the processed messages, per command. */
+void GetMessageLatencyStats(
+    std::map<std::string, CMessageLatencyStats> &mapStats);
 /** Increase a node's misbehavior score. */
 void Misbehaving(NodeId nodeid, int howmuch, const std::string &reason = "");
 
@@ -202,6 +202,28 @@ struct timeval MillisToTimeval(int64_t nTimeout) {
     return timeout;
 }
 
+/**
+ * Wait for at most nTimeout milliseconds until hSocket is ready for reading,
+ * or for writing if fWrite is set. Returns 1 if the socket is ready, 0 on
+ * timeout or SOCKET_ERROR.
+ */
+static int WaitForSocket(const SOCKET &hSocket, bool fWrite, int64_t nTimeout) {
+#ifdef USE_EPOLL
+    // The socket may be beyond FD_SETSIZE, so select() cannot be used.
+    struct pollfd pollfd = {};
+    pollfd.fd = hSocket;
+    pollfd.events = fWrite ? POLLOUT : POLLIN;
+    return poll(&pollfd, 1, nTimeout);
+#else
+    struct timeval timeout = MillisToTimeval(nTimeout);
+    fd_set fdset;
+    FD_ZERO(&fdset);
+    FD_SET(hSocket, &fdset);
+    return select(hSocket + 1, fWrite ? nullptr : &fdset,
+                  fWrite ? &fdset : nullptr, nullptr, &timeout);
+#endif
+}
+
 /** SOCKS version */
 enum SOCKSVersion : uint8_t { SOCKS4 = 0x04, SOCKS5 = 0x05 };
 
@@ -284,12 +306,8 @@ static IntrRecvError InterruptibleRecv(uint8_t *data, size_t len, int timeout,
                 if (!IsSelectableSocket(hSocket)) {
                     return IntrRecvError::NetworkError;
                 }
-                struct timeval tval =
-                    MillisToTimeval(std::min(endTime - curTime, maxWait));
-                fd_set fdset;
-                FD_ZERO(&fdset);
-                FD_SET(hSocket, &fdset);
-                int nRet = select(hSocket + 1, &fdset, nullptr, nullptr, &tval);
+                int nRet = WaitForSocket(hSocket, false,
+                                         std::min(endTime - curTime, maxWait));
                 if (nRet == SOCKET_ERROR) {
                     return IntrRecvError::NetworkError;
                 }
@@ -554,11 +572,7 @@ bool ConnectSocketDirectly(const CService &addrConnect, const SOCKET &hSocket,
         // WSAEINVAL is here because some legacy version of winsock uses it
         if (nErr == WSAEINPROGRESS || nErr == WSAEWOULDBLOCK ||
             nErr == WSAEINVAL) {
-            struct timeval timeout = MillisToTimeval(nTimeout);
-            fd_set fdset;
-            FD_ZERO(&fdset);
-            FD_SET(hSocket, &fdset);
-            int nRet = select(hSocket + 1, nullptr, &fdset, nullptr, &timeout);
+            int nRet = WaitForSocket(hSocket, true, nTimeout);
             if (nRet == 0) {
                 LogPrint(BCLog::NET, "connection to %s timeout\n",
                          addrConnect.ToString());
@@ -28,6 +28,26 @@ public:
         return Make(0, std::move(sCommand), std::forward<Args>(args)...);
     }
 
+    /**
+     * Serialize a payload once, so that it can be sent to many peers using
+     * Make(sCommand, payload).
+     */
+    template <typename... Args>
+    CNetMsgPayloadRef MakePayload(Args &&... args) const {
+        std::vector<uint8_t> data;
+        CVectorWriter{SER_NETWORK, nVersion, data, 0,
+                      std::forward<Args>(args)...};
+        return std::make_shared<const CNetMsgPayload>(std::move(data));
+    }
+
+    CSerializedNetMsg Make(std::string sCommand,
+                           CNetMsgPayloadRef payload) const {
+        CSerializedNetMsg msg;
+        msg.command = std::move(sCommand);
+        msg.payload = std::move(payload);
+        return msg;
+    }
+
 private:
     const int nVersion;
 };
@@ -8,6 +8,9 @@
 #include <feerate.h>
 #include <policy/fees.h>
 
+#include <algorithm>
+#include <cassert>
+
 FeeFilterRounder::FeeFilterRounder(const CFeeRate &minIncrementalFee) {
     Amount minFeeLimit = std::max(SATOSHI, minIncrementalFee.GetFeePerK() / 2);
     feeset.insert(Amount::zero());
@@ -27,3 +30,77 @@ Amount FeeFilterRounder::round(const Amount currentMinFee) {
 
     return *it;
 }
+
+FeeRateHistogram::FeeRateHistogram() {
+    buckets.push_back({Amount::zero(), 0, 0, Amount::zero()});
+    for (double bucketBoundary = MIN_FEERATE / SATOSHI;
+         bucketBoundary <= double(MAX_FEERATE / SATOSHI);
+         bucketBoundary *= FEE_SPACING) {
+        const Amount feeRate = int64_t(bucketBoundary) * SATOSHI;
+        if (feeRate > buckets.back().feeRate) {
+            buckets.push_back({feeRate, 0, 0, Amount::zero()});
+        }
+    }
+}
+
+FeeRateHistogram::Bucket &FeeRateHistogram::GetBucket(const Amount fee,
+                                                      size_t size) {
+    const Amount feeRate = CFeeRate(fee, size).GetFeePerK();
+    // Find the last bucket whose lower bound is not above feeRate.
+    auto it = std::upper_bound(
+        buckets.begin() + 1, buckets.end(), feeRate,
+        [](const Amount a, const Bucket &b) { return a < b.feeRate; });
+    return *(it - 1);
+}
+
+void FeeRateHistogram::AddTx(const Amount fee, size_t size) {
+    Bucket &bucket = GetBucket(fee, size);
+    bucket.count++;
+    bucket.bytes += size;
+    bucket.fees += fee;
+}
+
+void FeeRateHistogram::RemoveTx(const Amount fee, size_t size) {
+    Bucket &bucket = GetBucket(fee, size);
+    assert(bucket.count > 0 && bucket.bytes >= size);
+    bucket.count--;
+    bucket.bytes -= size;
+    bucket.fees -= fee;
+}
+
+void FeeRateHistogram::Clear() {
+    for (Bucket &bucket : buckets) {
+        bucket.count = 0;
+        bucket.bytes = 0;
+        bucket.fees = Amount::zero();
+    }
+}
+
+CFeeRate FeeRateHistogram::EstimateFeeRate(uint64_t nBytes) const {
+    uint64_t nCumulativeBytes = 0;
+    for (size_t i = buckets.size(); i-- > 0;) {
+        nCumulativeBytes += buckets[i].bytes;
+        if (nCumulativeBytes >= nBytes && buckets[i].count > 0) {
+            // Paying the upper bound of this bucket outbids all the
+            // transactions in it.
+            return CFeeRate(i + 1 < buckets.size() ? buckets[i + 1].feeRate
+                                                   : MAX_FEERATE);
+        }
+    }
+    return CFeeRate(Amount::zero());
+}
+
+bool FeeRateHistogram::operator==(const FeeRateHistogram &other) const {
+    if (buckets.size() != other.buckets.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < buckets.size(); i++) {
+        const Bucket &a = buckets[i];
+        const Bucket &b = other.buckets[i];
+        if (a.feeRate != b.feeRate || a.count != b.count ||
+            a.bytes != b.bytes || a.fees != b.fees) {
+            return false;
+        }
+    }
+    return true;
+}
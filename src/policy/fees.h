@@ -9,7 +9,9 @@
 #include <random.h>
 #include <uint256.h>
 
+#include <cstdint>
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -38,4 +40,45 @@ private:
     FastRandomContext insecure_rand;
 };
 
+/**
+ * Histogram of the fee rates of a set of transactions, typically the mempool,
+ * maintained incrementally as transactions are added and removed.
+ *
+ * Buckets are exponentially spaced between MIN_FEERATE and MAX_FEERATE, the
+ * first bucket also holding all the lower fee rates and the last one all the
+ * higher fee rates.
+ */
+class FeeRateHistogram {
+public:
+    struct Bucket {
+        //! Lowest fee rate of the transactions in this bucket, per kB.
+        Amount feeRate;
+        uint64_t count;
+        uint64_t bytes;
+        Amount fees;
+    };
+
+    FeeRateHistogram();
+
+    void AddTx(const Amount fee, size_t size);
+    void RemoveTx(const Amount fee, size_t size);
+    void Clear();
+
+    /**
+     * Estimate the fee rate a transaction must pay to be among the first
+     * nBytes bytes of transactions when sorted by decreasing fee rate. Returns
+     * a zero fee rate if the histogram holds less than nBytes bytes.
+     */
+    CFeeRate EstimateFeeRate(uint64_t nBytes) const;
+
+    const std::vector<Bucket> &GetBuckets() const { return buckets; }
+
+    bool operator==(const FeeRateHistogram &other) const;
+
+private:
+    std::vector<Bucket> buckets;
+
+    Bucket &GetBucket(const Amount fee, size_t size);
+};
+
 #endif // BITCOIN_POLICY_FEES_H
@@ -1688,6 +1688,31 @@ static UniValue getchaintips(const Config &config,
     return res;
 }
 
+UniValue MempoolFeeHistogramToJSON(const CTxMemPool &pool) {
+    const FeeRateHistogram histogram = pool.GetFeeHistogram();
+    const std::vector<FeeRateHistogram::Bucket> &buckets =
+        histogram.GetBuckets();
+
+    UniValue ret(UniValue::VARR);
+    uint64_t nCumulativeBytes = 0;
+    for (auto it = buckets.rbegin(); it != buckets.rend(); ++it) {
+        if (it->count == 0) {
+            continue;
+        }
+
+        nCumulativeBytes += it->bytes;
+        UniValue bucket(UniValue::VOBJ);
+        bucket.pushKV("feerate", ValueFromAmount(it->feeRate));
+        bucket.pushKV("count", it->count);
+        bucket.pushKV("size", it->bytes);
+        bucket.pushKV("fees", ValueFromAmount(it->fees));
+        bucket.pushKV("cumulativesize", nCumulativeBytes);
+        ret.push_back(bucket);
+    }
+
+    return ret;
+}
+
 UniValue MempoolInfoToJSON(const CTxMemPool &pool) {
     UniValue ret(UniValue::VOBJ);
     ret.pushKV("loaded", pool.IsLoaded());
@@ -1702,6 +1727,7 @@ UniValue MempoolInfoToJSON(const CTxMemPool &pool) {
         ValueFromAmount(std::max(pool.GetMinFee(maxmempool), ::minRelayTxFee)
                             .GetFeePerK()));
     ret.pushKV("minrelaytxfee", ValueFromAmount(::minRelayTxFee.GetFeePerK()));
+    ret.pushKV("feehistogram", MempoolFeeHistogramToJSON(pool));
 
     return ret;
 }
@@ -1731,6 +1757,8 @@ static UniValue getmempoolinfo(const Config &config,
             "minimum mempool fee\n"
             "  \"minrelaytxfee\": xxxxx       (numeric) Current minimum relay "
             "fee for transactions\n"
+            "  \"feehistogram\": [...]        (array) Fee rate histogram of "
+            "the mempool, see getmempoolfeehistogram\n"
             "}\n"
             "\nExamples:\n" +
             HelpExampleCli("getmempoolinfo", "") +
@@ -1740,6 +1768,47 @@ static UniValue getmempoolinfo(const Config &config,
     return MempoolInfoToJSON(::g_mempool);
 }
 
+static UniValue getmempoolfeehistogram(const Config &config,
+                                       const JSONRPCRequest &request) {
+    if (request.fHelp || request.params.size() != 0) {
+        throw std::runtime_error(
+            RPCHelpMan{"getmempoolfeehistogram",
+                       "\nReturns the distribution of the fee rates of the "
+                       "transactions in the TX memory pool.\n"
+                       "\nTransactions are grouped in exponentially spaced "
+                       "fee rate buckets, using their modified fees. Only non "
+                       "empty buckets are returned, from the highest fee rate "
+                       "to the lowest.\n",
+                       {}}
+                .ToString() +
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"feerate\": xxxxx,          (numeric) Lowest fee rate of "
+            "the bucket in " +
+            CURRENCY_UNIT +
+            "/kB\n"
+            "    \"count\": xxxxx,            (numeric) Number of "
+            "transactions in the bucket\n"
+            "    \"size\": xxxxx,             (numeric) Total size of the "
+            "transactions in the bucket\n"
+            "    \"fees\": xxxxx,             (numeric) Total fees of the "
+            "transactions in the bucket in " +
+            CURRENCY_UNIT +
+            "\n"
+            "    \"cumulativesize\": xxxxx    (numeric) Total size of the "
+            "transactions paying at least this fee rate\n"
+            "  },\n"
+            "  ...\n"
+            "]\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getmempoolfeehistogram", "") +
+            HelpExampleRpc("getmempoolfeehistogram", ""));
+    }
+
+    return MempoolFeeHistogramToJSON(::g_mempool);
+}
+
 static UniValue preciousblock(const Config &config,
                               const JSONRPCRequest &request) {
     if (request.fHelp || request.params.size() != 1) {
@@ -2766,6 +2835,7 @@ static const ContextFreeRPCCommand commands[] = {
     { "blockchain",         "getmempoolancestors",    getmempoolancestors,    {"txid","verbose"} },
     { "blockchain",         "getmempooldescendants",  getmempooldescendants,  {"txid","verbose"} },
     { "blockchain",         "getmempoolentry",        getmempoolentry,        {"txid"} },
+    { "blockchain",         "getmempoolfeehistogram", getmempoolfeehistogram, {} },
     { "blockchain",         "getmempoolinfo",         getmempoolinfo,         {} },
     { "blockchain",         "getrawmempool",          getrawmempool,          {"verbose"} },
     { "blockchain",         "gettxout",               gettxout,               {"txid","n","include_mempool"} },
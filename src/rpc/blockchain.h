@@ -33,6 +33,9 @@ UniValue blockToJSON(const CBlock &block, const CBlockIndex *tip,
 /** Mempool information to JSON */
 UniValue MempoolInfoToJSON(const CTxMemPool &pool);
 
+/** Mempool fee rate histogram to JSON */
+UniValue MempoolFeeHistogramToJSON(const CTxMemPool &pool);
+
 /** Mempool to JSON */
 UniValue MempoolToJSON(const CTxMemPool &pool, bool verbose = false);
 
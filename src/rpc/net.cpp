@@ -479,6 +479,19 @@ static UniValue getnettotals(const Config &config,
             "left in current time cycle\n"
             "    \"time_left_in_cycle\": t                 (numeric) Seconds "
             "left in current time cycle\n"
+            "  },\n"
+            "  \"msglatency\": {\n"
+            "    \"msg\": {                 (json object) Messages processed "
+            "for a given command\n"
+            "      \"count\": n,            (numeric) Number of messages\n"
+            "      \"avglatency\": n,       (numeric) Average time between "
+            "the reception and the end of the processing, in microseconds\n"
+            "      \"maxlatency\": n,       (numeric) Maximum time between "
+            "the reception and the end of the processing, in microseconds\n"
+            "      \"avgprocessingtime\": n (numeric) Average processing "
+            "time, in microseconds\n"
+            "    },\n"
+            "    ...\n"
             "  }\n"
             "}\n"
             "\nExamples:\n" +
@@ -509,6 +522,21 @@ static UniValue getnettotals(const Config &config,
     outboundLimit.pushKV("time_left_in_cycle",
                          g_connman->GetMaxOutboundTimeLeftInCycle());
     obj.pushKV("uploadtarget", outboundLimit);
+
+    std::map<std::string, CMessageLatencyStats> mapMsgLatency;
+    GetMessageLatencyStats(mapMsgLatency);
+    UniValue msgLatency(UniValue::VOBJ);
+    for (const auto &it : mapMsgLatency) {
+        const CMessageLatencyStats &stats = it.second;
+        UniValue msg(UniValue::VOBJ);
+        msg.pushKV("count", stats.nCount);
+        msg.pushKV("avglatency", stats.nTotalLatency / int64_t(stats.nCount));
+        msg.pushKV("maxlatency", stats.nMaxLatency);
+        msg.pushKV("avgprocessingtime",
+                   stats.nTotalProcessingTime / int64_t(stats.nCount));
+        msgLatency.pushKV(it.first, msg);
+    }
+    obj.pushKV("msglatency", msgLatency);
     return obj;
 }
 
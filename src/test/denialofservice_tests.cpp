@@ -13,7 +13,10 @@
 #include <net_processing.h>
 #include <pow.h>
 #include <script/sign.h>
+#include <script/standard.h>
 #include <serialize.h>
+#include <txmempool.h>
+#include <txorphanpool.h>
 #include <util/system.h>
 #include <util/time.h>
 #include <validation.h>
@@ -23,6 +26,9 @@
 #include <boost/test/unit_test.hpp>
 
 #include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
 
 struct CConnmanTest : public CConnman {
     using CConnman::CConnman;
@@ -42,16 +48,12 @@ struct CConnmanTest : public CConnman {
 // Tests these internal-to-net_processing.cpp methods:
 extern bool AddOrphanTx(const CTransactionRef &tx, NodeId peer);
 extern void EraseOrphansFor(NodeId peer);
-extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans);
+extern unsigned int LimitOrphanTxSize(unsigned int nMaxOrphans,
+                                      size_t nMaxOrphanBytes);
 
-struct COrphanTx {
-    CTransactionRef tx;
-    NodeId fromPeer;
-    int64_t nTimeExpire;
-};
 extern CCriticalSection g_cs_orphans;
-extern std::map<uint256, COrphanTx>
-    mapOrphanTransactions GUARDED_BY(g_cs_orphans);
+extern CTxOrphanPool g_orphanpool GUARDED_BY(g_cs_orphans);
+extern std::deque<COutPoint> g_orphan_work_queue GUARDED_BY(g_cs_orphans);
 
 static CService ip(uint32_t i) {
     struct in_addr s;
@@ -393,14 +395,15 @@ BOOST_AUTO_TEST_CASE(DoS_bantime) {
     peerLogic->FinalizeNode(config, dummyNode.GetId(), dummy);
 }
 
-static CTransactionRef RandomOrphan() {
-    std::map<uint256, COrphanTx>::iterator it;
+static CTransactionRef
+RandomOrphan(const std::vector<CTransactionRef> &orphans) {
     LOCK2(cs_main, g_cs_orphans);
-    it = mapOrphanTransactions.lower_bound(InsecureRand256());
-    if (it == mapOrphanTransactions.end()) {
-        it = mapOrphanTransactions.begin();
+    while (true) {
+        const CTransactionRef &tx = orphans[InsecureRandRange(orphans.size())];
+        if (g_orphanpool.HaveTx(tx->GetId())) {
+            return tx;
+        }
     }
-    return it->second.tx;
 }
 
 BOOST_AUTO_TEST_CASE(DoS_mapOrphans) {
@@ -409,6 +412,8 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans) {
     CBasicKeyStore keystore;
     keystore.AddKey(key);
 
+    std::vector<CTransactionRef> orphans;
+
     // 50 orphan transactions:
     for (int i = 0; i < 50; i++) {
         CMutableTransaction tx;
@@ -420,12 +425,13 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans) {
         tx.vout[0].scriptPubKey =
             GetScriptForDestination(key.GetPubKey().GetID());
 
-        AddOrphanTx(MakeTransactionRef(tx), i);
+        orphans.push_back(MakeTransactionRef(tx));
+        AddOrphanTx(orphans.back(), i);
     }
 
     // ... and 50 that depend on other orphans:
     for (int i = 0; i < 50; i++) {
-        CTransactionRef txPrev = RandomOrphan();
+        CTransactionRef txPrev = RandomOrphan(orphans);
 
         CMutableTransaction tx;
         tx.vin.resize(1);
@@ -436,12 +442,13 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans) {
             GetScriptForDestination(key.GetPubKey().GetID());
         SignSignature(keystore, *txPrev, tx, 0, SigHashType());
 
-        AddOrphanTx(MakeTransactionRef(tx), i);
+        orphans.push_back(MakeTransactionRef(tx));
+        AddOrphanTx(orphans.back(), i);
     }
 
     // This really-big orphan should be ignored:
     for (int i = 0; i < 10; i++) {
-        CTransactionRef txPrev = RandomOrphan();
+        CTransactionRef txPrev = RandomOrphan(orphans);
 
         CMutableTransaction tx;
         tx.vout.resize(1);
@@ -465,18 +472,121 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans) {
     LOCK2(cs_main, g_cs_orphans);
     // Test EraseOrphansFor:
     for (NodeId i = 0; i < 3; i++) {
-        size_t sizeBefore = mapOrphanTransactions.size();
+        size_t sizeBefore = g_orphanpool.Size();
         EraseOrphansFor(i);
-        BOOST_CHECK(mapOrphanTransactions.size() < sizeBefore);
+        BOOST_CHECK(g_orphanpool.Size() < sizeBefore);
+        BOOST_CHECK_EQUAL(g_orphanpool.PeerCount(i), 0);
     }
 
     // Test LimitOrphanTxSize() function:
-    LimitOrphanTxSize(40);
-    BOOST_CHECK(mapOrphanTransactions.size() <= 40);
-    LimitOrphanTxSize(10);
-    BOOST_CHECK(mapOrphanTransactions.size() <= 10);
-    LimitOrphanTxSize(0);
-    BOOST_CHECK(mapOrphanTransactions.empty());
+    const size_t nMaxBytes = std::numeric_limits<size_t>::max();
+    LimitOrphanTxSize(40, nMaxBytes);
+    BOOST_CHECK(g_orphanpool.Size() <= 40);
+    LimitOrphanTxSize(10, nMaxBytes);
+    BOOST_CHECK(g_orphanpool.Size() <= 10);
+    LimitOrphanTxSize(10, 0);
+    BOOST_CHECK_EQUAL(g_orphanpool.Size(), 0);
+    BOOST_CHECK_EQUAL(g_orphanpool.TotalBytes(), 0);
+    LimitOrphanTxSize(0, nMaxBytes);
+    BOOST_CHECK_EQUAL(g_orphanpool.Size(), 0);
+}
+
+BOOST_FIXTURE_TEST_CASE(DoS_orphans_reprocessed_on_block, TestChain100Setup) {
+    const Config &config = GetConfig();
+    std::atomic<bool> interruptDummy(false);
+
+    auto connman = std::make_unique<CConnman>(config, 0x1337, 0x1337);
+    auto peerLogic = std::make_unique<PeerLogicValidation>(
+        connman.get(), nullptr, scheduler, false);
+
+    // The test blocks are timestamped with the current time, make sure the
+    // transactions below are not subject to replay protection.
+    gArgs.ForceSetArg("-replayprotectionactivationtime",
+                      std::to_string(std::numeric_limits<int64_t>::max()));
+
+    CBasicKeyStore keystore;
+    keystore.AddKey(coinbaseKey);
+    const CScript scriptPubKey =
+        GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+
+    // A parent transaction with enough outputs to fund more orphans than can
+    // be reprocessed in a single batch.
+    const size_t nOrphans = ORPHAN_REPROCESS_BATCH_SIZE + 10;
+    CMutableTransaction parent;
+    parent.vin.emplace_back(COutPoint(m_coinbase_txns[0]->GetId(), 0));
+    parent.vout.resize(nOrphans);
+    for (CTxOut &txout : parent.vout) {
+        txout.nValue = m_coinbase_txns[0]->vout[0].nValue / int64_t(nOrphans) -
+                       10000 * SATOSHI;
+        txout.scriptPubKey = scriptPubKey;
+    }
+    BOOST_CHECK(SignSignature(keystore, *m_coinbase_txns[0], parent, 0,
+                              SigHashType().withForkId()));
+    const CTransaction parentTx(parent);
+
+    {
+        LOCK(g_cs_orphans);
+        g_orphanpool.Clear();
+        g_orphan_work_queue.clear();
+        for (size_t i = 0; i < nOrphans; i++) {
+            CMutableTransaction child;
+            child.vin.emplace_back(COutPoint(parentTx.GetId(), i));
+            child.vout.emplace_back(parent.vout[i].nValue - 10000 * SATOSHI,
+                                    scriptPubKey);
+            BOOST_CHECK(SignSignature(keystore, parentTx, child, 0,
+                                      SigHashType().withForkId()));
+            BOOST_CHECK(AddOrphanTx(MakeTransactionRef(child), 0));
+        }
+        BOOST_CHECK_EQUAL(g_orphanpool.Size(), nOrphans);
+        BOOST_CHECK(g_orphan_work_queue.empty());
+    }
+
+    // Mine the parent. All the orphans spending it are queued for
+    // reprocessing.
+    CBlock block = CreateAndProcessBlock({parent}, scriptPubKey);
+    const CBlockIndex *pindex;
+    {
+        LOCK(cs_main);
+        pindex = ::ChainActive().Tip();
+        BOOST_CHECK_EQUAL(pindex->GetBlockHash(), block.GetHash());
+    }
+    peerLogic->BlockConnected(std::make_shared<const CBlock>(block), pindex,
+                              {});
+    {
+        LOCK(g_cs_orphans);
+        BOOST_CHECK_EQUAL(g_orphan_work_queue.size(), nOrphans);
+    }
+
+    CAddress addr(ip(0xa0b0c001), NODE_NONE);
+    CNode dummyNode(id++, NODE_NETWORK, 0, INVALID_SOCKET, addr, 0, 0,
+                    CAddress(), "", true);
+    dummyNode.SetSendVersion(PROTOCOL_VERSION);
+    peerLogic->InitializeNode(config, &dummyNode);
+    dummyNode.nVersion = 1;
+    dummyNode.fSuccessfullyConnected = true;
+
+    // The message handler reconsiders one batch at a time.
+    peerLogic->ProcessMessages(config, &dummyNode, interruptDummy);
+    {
+        LOCK(g_cs_orphans);
+        BOOST_CHECK_EQUAL(g_orphan_work_queue.size(),
+                          nOrphans - ORPHAN_REPROCESS_BATCH_SIZE);
+        BOOST_CHECK_EQUAL(g_orphanpool.Size(),
+                          nOrphans - ORPHAN_REPROCESS_BATCH_SIZE);
+    }
+    BOOST_CHECK_EQUAL(g_mempool.size(), ORPHAN_REPROCESS_BATCH_SIZE);
+
+    peerLogic->ProcessMessages(config, &dummyNode, interruptDummy);
+    {
+        LOCK(g_cs_orphans);
+        BOOST_CHECK(g_orphan_work_queue.empty());
+        BOOST_CHECK_EQUAL(g_orphanpool.Size(), 0);
+    }
+    BOOST_CHECK_EQUAL(g_mempool.size(), nOrphans);
+
+    bool dummy;
+    peerLogic->FinalizeNode(config, dummyNode.GetId(), dummy);
+    gArgs.ClearArg("-replayprotectionactivationtime");
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 #include <policy/fees.h>
 #include <policy/policy.h>
 
+#include <feerate.h>
 #include <txmempool.h>
 #include <uint256.h>
 #include <util/system.h>
@@ -98,4 +99,120 @@ BOOST_AUTO_TEST_CASE(MempoolMinimumFeeEstimate) {
                         "Confirm blocks has failed");
 }
 
+BOOST_AUTO_TEST_CASE(FeeRateHistogramBuckets) {
+    FeeRateHistogram histogram;
+    const std::vector<FeeRateHistogram::Bucket> &buckets =
+        histogram.GetBuckets();
+    BOOST_CHECK_EQUAL(buckets.front().feeRate, Amount::zero());
+    for (size_t i = 1; i < buckets.size(); i++) {
+        BOOST_CHECK(buckets[i].feeRate > buckets[i - 1].feeRate);
+    }
+    BOOST_CHECK(buckets.back().feeRate <= MAX_FEERATE);
+
+    auto nonEmptyBucket = [&]() {
+        for (const FeeRateHistogram::Bucket &bucket : buckets) {
+            if (bucket.count > 0) {
+                return bucket.feeRate;
+            }
+        }
+        return -SATOSHI;
+    };
+
+    // Fee rates fall in the bucket with the highest lower bound not above
+    // them.
+    histogram.AddTx(5000 * SATOSHI, 1000);
+    const Amount lowBucket = nonEmptyBucket();
+    BOOST_CHECK(lowBucket <= 5000 * SATOSHI);
+    BOOST_CHECK(lowBucket * FEE_SPACING > 5000 * SATOSHI);
+    histogram.RemoveTx(5000 * SATOSHI, 1000);
+    BOOST_CHECK(histogram == FeeRateHistogram());
+
+    // Very low and very high fee rates are kept in the first and last
+    // buckets.
+    histogram.AddTx(-SATOSHI, 100);
+    histogram.AddTx(2 * MAX_FEERATE, 1000);
+    BOOST_CHECK_EQUAL(buckets.front().count, 1);
+    BOOST_CHECK_EQUAL(buckets.back().count, 1);
+    BOOST_CHECK_EQUAL(buckets.back().fees, 2 * MAX_FEERATE);
+    histogram.Clear();
+    BOOST_CHECK(histogram == FeeRateHistogram());
+
+    // 1000 bytes at 1000 sat/kB, 2000 bytes at 10000 sat/kB and 500 bytes at
+    // 100000 sat/kB.
+    histogram.AddTx(1000 * SATOSHI, 1000);
+    histogram.AddTx(10000 * SATOSHI, 1000);
+    histogram.AddTx(10000 * SATOSHI, 1000);
+    histogram.AddTx(50000 * SATOSHI, 500);
+
+    // The top 500 bytes only contain the highest fee rate transaction.
+    CFeeRate estimate = histogram.EstimateFeeRate(500);
+    BOOST_CHECK(estimate > CFeeRate(100000 * SATOSHI));
+    // A transaction must outbid the 10000 sat/kB ones to be in the top 2000
+    // bytes.
+    estimate = histogram.EstimateFeeRate(2000);
+    BOOST_CHECK(estimate > CFeeRate(10000 * SATOSHI));
+    BOOST_CHECK(estimate < CFeeRate(100000 * SATOSHI));
+    estimate = histogram.EstimateFeeRate(3500);
+    BOOST_CHECK(estimate > CFeeRate(1000 * SATOSHI));
+    BOOST_CHECK(estimate < CFeeRate(10000 * SATOSHI));
+    // There are not enough transactions to fill 3501 bytes.
+    BOOST_CHECK(histogram.EstimateFeeRate(3501) == CFeeRate(Amount::zero()));
+}
+
+BOOST_AUTO_TEST_CASE(MempoolFeeHistogramEstimate) {
+    CTxMemPool mpool;
+    LOCK2(cs_main, mpool.cs);
+    TestMemPoolEntryHelper entry;
+
+    // Large transactions, so that a few of them fill a block.
+    CScript garbage;
+    for (unsigned int i = 0; i < 10000; i++) {
+        garbage.push_back('X');
+    }
+
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].scriptSig = garbage;
+    tx.vout.resize(1);
+    tx.vout[0].nValue = Amount::zero();
+    const size_t txSize = CTransaction(tx).GetTotalSize();
+    const size_t nTxPerBlock = DEFAULT_MAX_GENERATED_BLOCK_SIZE / txSize;
+
+    // Less than a block worth of high fee transactions doesn't raise the
+    // estimate.
+    const CFeeRate highFeeRate(100 * DEFAULT_BLOCK_MIN_TX_FEE_PER_KB);
+    std::vector<TxId> txids;
+    for (size_t i = 0; i < nTxPerBlock; i++) {
+        tx.vin[0].nSequence = i;
+        txids.push_back(tx.GetId());
+        mpool.addUnchecked(
+            entry.Fee(highFeeRate.GetFee(txSize)).Time(GetTime()).FromTx(tx));
+    }
+    BOOST_CHECK(mpool.estimateFee() < highFeeRate);
+
+    // Once more than a block worth of transactions pays it, a transaction
+    // must outbid the high fee rate.
+    tx.vin[0].nSequence = nTxPerBlock;
+    mpool.addUnchecked(
+        entry.Fee(highFeeRate.GetFee(txSize)).Time(GetTime()).FromTx(tx));
+    BOOST_CHECK(mpool.estimateFee() > highFeeRate);
+    BOOST_CHECK(mpool.estimateFee() < CFeeRate(2 * highFeeRate.GetFeePerK()));
+
+    // Deprioritising a transaction moves it to a lower bucket.
+    mpool.PrioritiseTransaction(txids[0], -highFeeRate.GetFee(txSize));
+    BOOST_CHECK(mpool.estimateFee() < highFeeRate);
+    BOOST_CHECK_EQUAL(mpool.GetFeeHistogram().GetBuckets().front().count, 1);
+
+    // The histogram is kept in sync as transactions are removed.
+    mpool.removeRecursive(CTransaction(tx));
+    FeeRateHistogram expected;
+    expected.AddTx(Amount::zero(), txSize);
+    for (size_t i = 1; i < nTxPerBlock; i++) {
+        expected.AddTx(highFeeRate.GetFee(txSize), txSize);
+    }
+    BOOST_CHECK(mpool.GetFeeHistogram() == expected);
+    mpool.clear();
+    BOOST_CHECK(mpool.GetFeeHistogram() == FeeRateHistogram());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
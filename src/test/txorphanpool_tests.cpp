@@ -0,0 +1,208 @@
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <txorphanpool.h>
+
+#include <policy/policy.h>
+#include <primitives/block.h>
+#include <random.h>
+
+#include <test/setup_common.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <vector>
+
+BOOST_FIXTURE_TEST_SUITE(txorphanpool_tests, BasicTestingSetup)
+
+static CTransactionRef MakeOrphan(const std::vector<COutPoint> &prevouts,
+                                  size_t nOutputs = 1) {
+    CMutableTransaction tx;
+    for (const COutPoint &prevout : prevouts) {
+        tx.vin.emplace_back(prevout);
+        tx.vin.back().scriptSig << OP_1;
+    }
+    tx.vout.resize(nOutputs);
+    for (CTxOut &txout : tx.vout) {
+        txout.nValue = 1 * CENT;
+        txout.scriptPubKey = CScript() << OP_1 << OP_EQUAL;
+    }
+    return MakeTransactionRef(tx);
+}
+
+static CTransactionRef MakeOrphan() {
+    return MakeOrphan({COutPoint(TxId(InsecureRand256()), 0)});
+}
+
+BOOST_AUTO_TEST_CASE(add_and_erase) {
+    CTxOrphanPool pool;
+    CTransactionRef tx = MakeOrphan();
+
+    BOOST_CHECK(pool.AddTx(tx, 1, 100));
+    BOOST_CHECK(!pool.AddTx(tx, 2, 100));
+    BOOST_CHECK(pool.HaveTx(tx->GetId()));
+    BOOST_CHECK_EQUAL(pool.Size(), 1);
+    BOOST_CHECK_EQUAL(pool.TotalBytes(), tx->GetTotalSize());
+    BOOST_CHECK_EQUAL(pool.PeerCount(1), 1);
+    BOOST_CHECK_EQUAL(pool.PeerCount(2), 0);
+
+    const CTxOrphanPool::Entry *entry = pool.GetTx(tx->GetId());
+    BOOST_CHECK(entry != nullptr);
+    BOOST_CHECK(entry->tx == tx);
+    BOOST_CHECK_EQUAL(entry->fromPeer, 1);
+    BOOST_CHECK_EQUAL(entry->nTimeExpire, 100);
+
+    std::vector<TxId> vChildren;
+    pool.GetChildren(tx->vin[0].prevout, vChildren);
+    BOOST_CHECK(vChildren == std::vector<TxId>{tx->GetId()});
+
+    BOOST_CHECK_EQUAL(pool.EraseTx(tx->GetId()), 1);
+    BOOST_CHECK_EQUAL(pool.EraseTx(tx->GetId()), 0);
+    BOOST_CHECK(!pool.HaveTx(tx->GetId()));
+    BOOST_CHECK(pool.GetTx(tx->GetId()) == nullptr);
+    BOOST_CHECK_EQUAL(pool.Size(), 0);
+    BOOST_CHECK_EQUAL(pool.TotalBytes(), 0);
+    BOOST_CHECK_EQUAL(pool.PeerCount(1), 0);
+
+    vChildren.clear();
+    pool.GetChildren(tx->vin[0].prevout, vChildren);
+    BOOST_CHECK(vChildren.empty());
+}
+
+BOOST_AUTO_TEST_CASE(large_orphan) {
+    CTxOrphanPool pool;
+
+    std::vector<COutPoint> prevouts;
+    for (int i = 0; i < 2777; i++) {
+        prevouts.emplace_back(TxId(InsecureRand256()), i);
+    }
+    CTransactionRef tx = MakeOrphan(prevouts);
+    BOOST_CHECK(tx->GetTotalSize() >= MAX_STANDARD_TX_SIZE);
+    BOOST_CHECK(!pool.AddTx(tx, 0, 0));
+    BOOST_CHECK_EQUAL(pool.Size(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(shared_prevout) {
+    CTxOrphanPool pool;
+    const COutPoint prevout(TxId(InsecureRand256()), 0);
+
+    CTransactionRef tx1 = MakeOrphan({prevout});
+    CTransactionRef tx2 =
+        MakeOrphan({prevout, COutPoint(TxId(InsecureRand256()), 1)});
+    BOOST_CHECK(pool.AddTx(tx1, 0, 0));
+    BOOST_CHECK(pool.AddTx(tx2, 1, 0));
+
+    std::vector<TxId> vChildren;
+    pool.GetChildren(prevout, vChildren);
+    BOOST_CHECK_EQUAL(vChildren.size(), 2);
+
+    pool.EraseTx(tx1->GetId());
+    vChildren.clear();
+    pool.GetChildren(prevout, vChildren);
+    BOOST_CHECK(vChildren == std::vector<TxId>{tx2->GetId()});
+}
+
+BOOST_AUTO_TEST_CASE(erase_for_peer) {
+    CTxOrphanPool pool;
+    std::vector<CTransactionRef> orphans;
+    for (int i = 0; i < 100; i++) {
+        orphans.push_back(MakeOrphan());
+        BOOST_CHECK(pool.AddTx(orphans.back(), i % 10, 0));
+    }
+
+    for (NodeId peer = 0; peer < 10; peer++) {
+        BOOST_CHECK_EQUAL(pool.PeerCount(peer), 10);
+    }
+
+    // Erase some orphans out of order to shuffle the per-peer lists.
+    for (int i = 0; i < 100; i += 7) {
+        BOOST_CHECK_EQUAL(pool.EraseTx(orphans[i]->GetId()), 1);
+    }
+
+    size_t nRemaining = pool.Size();
+    for (NodeId peer = 0; peer < 10; peer++) {
+        const size_t nPeerOrphans = pool.PeerCount(peer);
+        BOOST_CHECK_EQUAL(pool.EraseForPeer(peer), nPeerOrphans);
+        BOOST_CHECK_EQUAL(pool.PeerCount(peer), 0);
+        nRemaining -= nPeerOrphans;
+        BOOST_CHECK_EQUAL(pool.Size(), nRemaining);
+    }
+
+    BOOST_CHECK_EQUAL(pool.Size(), 0);
+    BOOST_CHECK_EQUAL(pool.TotalBytes(), 0);
+    BOOST_CHECK_EQUAL(pool.EraseForPeer(0), 0);
+}
+
+BOOST_AUTO_TEST_CASE(limit_size) {
+    CTxOrphanPool pool;
+    FastRandomContext rng(true);
+    size_t nTotalBytes = 0;
+    for (int i = 0; i < 100; i++) {
+        CTransactionRef tx = MakeOrphan();
+        nTotalBytes += tx->GetTotalSize();
+        BOOST_CHECK(pool.AddTx(tx, i, 0));
+    }
+    BOOST_CHECK_EQUAL(pool.TotalBytes(), nTotalBytes);
+
+    BOOST_CHECK_EQUAL(pool.LimitSize(100, nTotalBytes, rng), 0);
+    BOOST_CHECK_EQUAL(pool.LimitSize(40, nTotalBytes, rng), 60);
+    BOOST_CHECK_EQUAL(pool.Size(), 40);
+
+    // All orphans have the same size, so the byte limit can be checked
+    // precisely.
+    const size_t nOrphanBytes = nTotalBytes / 100;
+    BOOST_CHECK_EQUAL(pool.LimitSize(40, 10 * nOrphanBytes, rng), 30);
+    BOOST_CHECK_EQUAL(pool.Size(), 10);
+    BOOST_CHECK_EQUAL(pool.TotalBytes(), 10 * nOrphanBytes);
+
+    BOOST_CHECK_EQUAL(pool.LimitSize(0, nTotalBytes, rng), 10);
+    BOOST_CHECK_EQUAL(pool.Size(), 0);
+    BOOST_CHECK_EQUAL(pool.TotalBytes(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(erase_expired) {
+    CTxOrphanPool pool;
+    for (int i = 0; i < 10; i++) {
+        BOOST_CHECK(pool.AddTx(MakeOrphan(), 0, 100 + i));
+    }
+
+    int64_t nMinExpTime = 1000;
+    BOOST_CHECK_EQUAL(pool.EraseExpired(104, nMinExpTime), 5);
+    BOOST_CHECK_EQUAL(pool.Size(), 5);
+    BOOST_CHECK_EQUAL(nMinExpTime, 105);
+    BOOST_CHECK_EQUAL(pool.PeerCount(0), 5);
+}
+
+BOOST_AUTO_TEST_CASE(block_connected) {
+    CTxOrphanPool pool;
+
+    // A transaction that will be included in a block.
+    CTransactionRef parent = MakeOrphan(
+        {COutPoint(TxId(InsecureRand256()), 0)}, 2 /* nOutputs */);
+
+    // An orphan that conflicts with the block, and one that is a child of the
+    // block transaction.
+    CTransactionRef conflict = MakeOrphan({parent->vin[0].prevout});
+    CTransactionRef child = MakeOrphan({COutPoint(parent->GetId(), 1)});
+    CTransactionRef unrelated = MakeOrphan();
+    BOOST_CHECK(pool.AddTx(conflict, 0, 0));
+    BOOST_CHECK(pool.AddTx(child, 0, 0));
+    BOOST_CHECK(pool.AddTx(unrelated, 1, 0));
+
+    CBlock block;
+    block.vtx.push_back(parent);
+
+    BOOST_CHECK_EQUAL(pool.EraseForBlock(block), 1);
+    BOOST_CHECK(!pool.HaveTx(conflict->GetId()));
+    BOOST_CHECK(pool.HaveTx(child->GetId()));
+    BOOST_CHECK(pool.HaveTx(unrelated->GetId()));
+
+    std::vector<COutPoint> vOutpoints;
+    pool.GetSpentOutputs(block.vtx, vOutpoints);
+    BOOST_CHECK(vOutpoints ==
+                std::vector<COutPoint>{COutPoint(parent->GetId(), 1)});
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,17 +2,31 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include <clientversion.h>
+#include <chain.h>
 #include <config.h>
 #include <consensus/validation.h>
+#include <fs.h>
+#include <keystore.h>
 #include <primitives/transaction.h>
 #include <script/script.h>
+#include <script/sign.h>
+#include <script/standard.h>
+#include <streams.h>
 #include <txmempool.h>
+#include <util/system.h>
+#include <util/time.h>
 #include <validation.h>
 
 #include <test/setup_common.h>
 
 #include <boost/test/unit_test.hpp>
 
+#include <limits>
+#include <map>
+#include <string>
+#include <vector>
+
 BOOST_AUTO_TEST_SUITE(txvalidation_tests)
 
 /**
@@ -57,4 +71,147 @@ BOOST_FIXTURE_TEST_CASE(tx_mempool_reject_coinbase, TestChain100Setup) {
     BOOST_CHECK_EQUAL(nDoS, 100);
 }
 
+static CTransactionRef MakeSpend(const std::vector<COutPoint> &prevouts) {
+    CMutableTransaction mtx;
+    for (const COutPoint &prevout : prevouts) {
+        mtx.vin.emplace_back(prevout);
+    }
+    mtx.vout.emplace_back(1 * CENT, CScript() << OP_TRUE);
+    return MakeTransactionRef(mtx);
+}
+
+BOOST_FIXTURE_TEST_CASE(mempool_load_sort_by_ancestry, BasicTestingSetup) {
+    const TxId unknown(InsecureRand256());
+    const CTransactionRef a = MakeSpend({COutPoint(unknown, 0)});
+    const CTransactionRef b = MakeSpend({COutPoint(unknown, 1)});
+    const CTransactionRef c = MakeSpend({COutPoint(b->GetId(), 0)});
+    const CTransactionRef d = MakeSpend({COutPoint(unknown, 2)});
+    // e spends b twice, which must be counted as a single parent.
+    const CTransactionRef e = MakeSpend({COutPoint(c->GetId(), 0),
+                                         COutPoint(b->GetId(), 0),
+                                         COutPoint(b->GetId(), 1)});
+
+    auto getOrder = [](const std::vector<MempoolLoadEntry> &batch) {
+        std::vector<TxId> order;
+        for (const MempoolLoadEntry &entry : batch) {
+            order.push_back(entry.tx->GetId());
+        }
+        return order;
+    };
+
+    // Children come after their parents, unrelated transactions keep their
+    // relative order.
+    std::vector<MempoolLoadEntry> batch{{a, 0}, {e, 1}, {c, 2}, {d, 3}, {b, 4}};
+    SortMempoolBatchByAncestry(batch);
+    const std::vector<TxId> expected{a->GetId(), d->GetId(), b->GetId(),
+                                     c->GetId(), e->GetId()};
+    BOOST_CHECK(getOrder(batch) == expected);
+    BOOST_CHECK_EQUAL(batch[0].nTime, 0);
+    BOOST_CHECK_EQUAL(batch[4].nTime, 1);
+
+    // An already sorted batch is left untouched.
+    SortMempoolBatchByAncestry(batch);
+    BOOST_CHECK(getOrder(batch) == expected);
+
+    std::vector<MempoolLoadEntry> empty;
+    SortMempoolBatchByAncestry(empty);
+    BOOST_CHECK(empty.empty());
+}
+
+namespace {
+/**
+ * A chain with two signed transactions, the second one spending the first,
+ * which are not mined nor in the mempool yet.
+ */
+struct ChainedTxSetup : public TestChain100Setup {
+    CMutableTransaction parent;
+    CMutableTransaction child;
+
+    ChainedTxSetup() {
+        // The test blocks are timestamped with the current time, make sure
+        // the transactions below are not subject to replay protection.
+        gArgs.ForceSetArg("-replayprotectionactivationtime",
+                          std::to_string(std::numeric_limits<int64_t>::max()));
+
+        CBasicKeyStore keystore;
+        keystore.AddKey(coinbaseKey);
+        const CScript scriptPubKey =
+            GetScriptForDestination(coinbaseKey.GetPubKey().GetID());
+
+        parent.vin.emplace_back(COutPoint(m_coinbase_txns[0]->GetId(), 0));
+        parent.vout.emplace_back(
+            m_coinbase_txns[0]->vout[0].nValue - 10000 * SATOSHI,
+            scriptPubKey);
+        BOOST_CHECK(SignSignature(keystore, *m_coinbase_txns[0], parent, 0,
+                                  SigHashType().withForkId()));
+
+        child.vin.emplace_back(COutPoint(parent.GetId(), 0));
+        child.vout.emplace_back(parent.vout[0].nValue - 10000 * SATOSHI,
+                                scriptPubKey);
+        BOOST_CHECK(SignSignature(keystore, CTransaction(parent), child, 0,
+                                  SigHashType().withForkId()));
+    }
+
+    ~ChainedTxSetup() { gArgs.ClearArg("-replayprotectionactivationtime"); }
+};
+} // namespace
+
+/**
+ * Ensure that a child stored before its parent in mempool.dat is loaded.
+ */
+BOOST_FIXTURE_TEST_CASE(mempool_load_child_before_parent, ChainedTxSetup) {
+    const CTransactionRef parentTx = MakeTransactionRef(parent);
+    const CTransactionRef childTx = MakeTransactionRef(child);
+
+    {
+        const int64_t nTime = GetTime();
+        const int64_t nFeeDelta = 0;
+        CAutoFile file(fsbridge::fopen(GetDataDir() / "mempool.dat", "wb"),
+                       SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!file.IsNull());
+        file << uint64_t(1) << uint64_t(2);
+        file << childTx << nTime << nFeeDelta;
+        file << parentTx << nTime << nFeeDelta;
+        file << std::map<TxId, Amount>();
+    }
+
+    BOOST_CHECK(LoadMempool(GetConfig(), g_mempool));
+    BOOST_CHECK_EQUAL(g_mempool.size(), 2);
+    BOOST_CHECK(g_mempool.exists(parentTx->GetId()));
+    BOOST_CHECK(g_mempool.exists(childTx->GetId()));
+}
+
+/**
+ * Ensure that the transactions of a disconnected block are added back to the
+ * mempool.
+ */
+BOOST_FIXTURE_TEST_CASE(mempool_readd_after_reorg, ChainedTxSetup) {
+    const CScript scriptPubKey = CScript() << OP_TRUE;
+    CreateAndProcessBlock({parent, child}, scriptPubKey);
+
+    CBlockIndex *pindex;
+    {
+        LOCK(cs_main);
+        pindex = ::ChainActive().Tip();
+        BOOST_CHECK_EQUAL(pindex->nHeight, 101);
+    }
+    BOOST_CHECK_EQUAL(g_mempool.size(), 0);
+
+    CValidationState state;
+    BOOST_CHECK(InvalidateBlock(GetConfig(), state, pindex));
+    BOOST_CHECK(ActivateBestChain(GetConfig(), state));
+
+    LOCK2(cs_main, g_mempool.cs);
+    BOOST_CHECK_EQUAL(::ChainActive().Height(), 100);
+    BOOST_CHECK_EQUAL(g_mempool.size(), 2);
+    BOOST_CHECK(g_mempool.exists(parent.GetId()));
+    BOOST_CHECK(g_mempool.exists(child.GetId()));
+
+    // The child was added back after its parent, and the mempool state
+    // accounts for it.
+    auto it = g_mempool.mapTx.find(parent.GetId());
+    BOOST_REQUIRE(it != g_mempool.mapTx.end());
+    BOOST_CHECK_EQUAL(it->GetCountWithDescendants(), 2);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
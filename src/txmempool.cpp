@@ -458,6 +458,7 @@ void CTxMemPool::addUnchecked(const CTxMemPoolEntry &entry,
 
     nTransactionsUpdated++;
     totalTxSize += entry.GetTxSize();
+    feeHistogram.AddTx(newit->GetModifiedFee(), newit->GetTxSize());
 
     vTxHashes.emplace_back(tx.GetHash(), newit);
     newit->vTxHashesIdx = vTxHashes.size() - 1;
@@ -481,6 +482,7 @@ void CTxMemPool::removeUnchecked(txiter it, MemPoolRemovalReason reason) {
     }
 
     totalTxSize -= it->GetTxSize();
+    feeHistogram.RemoveTx(it->GetModifiedFee(), it->GetTxSize());
     cachedInnerUsage -= it->DynamicMemoryUsage();
     cachedInnerUsage -= memusage::DynamicUsage(mapLinks[it].parents) +
                         memusage::DynamicUsage(mapLinks[it].children);
@@ -666,6 +668,7 @@ void CTxMemPool::_clear() {
     mapNextTx.clear();
     vTxHashes.clear();
     totalTxSize = 0;
+    feeHistogram.Clear();
     cachedInnerUsage = 0;
     lastRollingFeeUpdate = GetTime();
     blockSinceLastRollingFeeBump = false;
@@ -824,6 +827,12 @@ void CTxMemPool::check(const CCoinsViewCache *pcoins) const {
 
     assert(totalTxSize == checkTotal);
     assert(innerUsage == cachedInnerUsage);
+
+    FeeRateHistogram checkHistogram;
+    for (const CTxMemPoolEntry &entry : mapTx) {
+        checkHistogram.AddTx(entry.GetModifiedFee(), entry.GetTxSize());
+    }
+    assert(checkHistogram == feeHistogram);
 }
 
 bool CTxMemPool::CompareDepthAndScore(const TxId &txida, const TxId &txidb) {
@@ -936,7 +945,12 @@ CFeeRate CTxMemPool::estimateFee() const {
     // may disagree with the rollingMinimumFeerate under certain scenarios
     // where the mempool  increases rapidly, or blocks are being mined which
     // do not contain propagated transactions.
-    return std::max(::minRelayTxFee, GetMinFee(maxMempoolSize));
+    // If the mempool holds more than a block worth of transactions, a new
+    // transaction also needs to outbid the ones which would fill the next
+    // block to be mined promptly.
+    return std::max({::minRelayTxFee, GetMinFee(maxMempoolSize),
+                     feeHistogram.EstimateFeeRate(
+                         DEFAULT_MAX_GENERATED_BLOCK_SIZE)});
 }
 
 void CTxMemPool::PrioritiseTransaction(const TxId &txid,
@@ -947,7 +961,9 @@ void CTxMemPool::PrioritiseTransaction(const TxId &txid,
         delta += nFeeDelta;
         txiter it = mapTx.find(txid);
         if (it != mapTx.end()) {
+            feeHistogram.RemoveTx(it->GetModifiedFee(), it->GetTxSize());
             mapTx.modify(it, update_fee_delta(delta));
+            feeHistogram.AddTx(it->GetModifiedFee(), it->GetTxSize());
             // Now update all ancestors' modified fees with descendants
             setEntries setAncestors;
             uint64_t nNoLimit = std::numeric_limits<uint64_t>::max();
@@ -1279,6 +1295,12 @@ SaltedTxidHasher::SaltedTxidHasher()
 /** Maximum bytes for transactions to store for processing during reorg */
 static const size_t MAX_DISCONNECTED_TX_POOL_SIZE = 20 * DEFAULT_MAX_BLOCK_SIZE;
 
+/**
+ * Number of disconnected transactions whose scripts are checked together
+ * before they are added back to the mempool.
+ */
+static const size_t REORG_READD_BATCH_SIZE = 1000;
+
 void DisconnectedBlockTransactions::addForBlock(
     const std::vector<CTransactionRef> &vtx) {
     for (const auto &tx : reverse_iterate(vtx)) {
@@ -1385,20 +1407,37 @@ void DisconnectedBlockTransactions::updateMempoolForReorg(const Config &config,
     // Iterate disconnectpool in reverse, so that we add transactions back to
     // the mempool starting with the earliest transaction that had been
     // previously seen in a block.
-    for (const CTransactionRef &tx :
-         reverse_iterate(queuedTx.get<insertion_order>())) {
-        // ignore validation errors in resurrected transactions
-        CValidationState stateDummy;
-        if (!fAddToMempool || tx->IsCoinBase() ||
-            !AcceptToMemoryPool(config, g_mempool, stateDummy, tx,
-                                nullptr /* pfMissingInputs */,
-                                true /* bypass_limits */,
-                                Amount::zero() /* nAbsurdFee */)) {
-            // If the transaction doesn't make it in to the mempool, remove any
-            // transactions that depend on it (which would now be orphans).
-            g_mempool.removeRecursive(*tx, MemPoolRemovalReason::REORG);
-        } else if (g_mempool.exists(tx->GetId())) {
-            txidsUpdate.push_back(tx->GetId());
+    // This is done in topologically ordered batches: the scripts of a whole
+    // batch are first checked on the script check threads, which fills the
+    // signature cache, so that adding the transactions back one by one under
+    // cs_main no longer verifies any signature.
+    std::vector<CTransactionRef> vBatch;
+    const auto itEnd = queuedTx.get<insertion_order>().rend();
+    for (auto it = queuedTx.get<insertion_order>().rbegin(); it != itEnd;) {
+        vBatch.clear();
+        for (; it != itEnd && vBatch.size() < REORG_READD_BATCH_SIZE; ++it) {
+            vBatch.push_back(*it);
+        }
+
+        if (fAddToMempool) {
+            PrevalidateTransactionScripts(config, g_mempool, vBatch);
+        }
+
+        for (const CTransactionRef &tx : vBatch) {
+            // ignore validation errors in resurrected transactions
+            CValidationState stateDummy;
+            if (!fAddToMempool || tx->IsCoinBase() ||
+                !AcceptToMemoryPool(config, g_mempool, stateDummy, tx,
+                                    nullptr /* pfMissingInputs */,
+                                    true /* bypass_limits */,
+                                    Amount::zero() /* nAbsurdFee */)) {
+                // If the transaction doesn't make it in to the mempool, remove
+                // any transactions that depend on it (which would now be
+                // orphans).
+                g_mempool.removeRecursive(*tx, MemPoolRemovalReason::REORG);
+            } else if (g_mempool.exists(tx->GetId())) {
+                txidsUpdate.push_back(tx->GetId());
+            }
         }
     }
 
@@ -10,6 +10,7 @@
 #include <coins.h>
 #include <crypto/siphash.h>
 #include <indirectmap.h>
+#include <policy/fees.h>
 #include <primitives/transaction.h>
 #include <random.h>
 #include <sync.h>
@@ -479,6 +480,8 @@ private:
 
     //! sum of all mempool tx's sizes.
     uint64_t totalTxSize;
+    //! fee rates of all mempool txs, using their modified fees.
+    FeeRateHistogram feeHistogram GUARDED_BY(cs);
     //! sum of dynamic memory usage of all the map elements (NOT the maps
     //! themselves)
     uint64_t cachedInnerUsage;
@@ -776,6 +779,11 @@ public:
         return totalTxSize;
     }
 
+    FeeRateHistogram GetFeeHistogram() const {
+        LOCK(cs);
+        return feeHistogram;
+    }
+
     bool exists(const TxId &txid) const {
         LOCK(cs);
         return mapTx.count(txid) != 0;
@@ -0,0 +1,245 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2016 The Bitcoin Core developers
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <txorphanpool.h>
+
+#include <logging.h>
+#include <policy/policy.h>
+#include <primitives/block.h>
+#include <random.h>
+
+#include <algorithm>
+
+bool CTxOrphanPool::AddTx(const CTransactionRef &tx, NodeId peer,
+                          int64_t nTimeExpire) {
+    const TxId &txid = tx->GetId();
+    if (m_orphans.count(txid)) {
+        return false;
+    }
+
+    // Ignore big transactions, to avoid a send-big-orphans memory exhaustion
+    // attack. If a peer has a legitimate large transaction with a missing
+    // parent then we assume it will rebroadcast it later, after the parent
+    // transaction(s) have been mined or received.
+    // 100 orphans, each of which is at most 99,999 bytes big is at most 10
+    // megabytes of orphans and somewhat more byprev index (in the worst case):
+    unsigned int sz = tx->GetTotalSize();
+    if (sz >= MAX_STANDARD_TX_SIZE) {
+        LogPrint(BCLog::MEMPOOL,
+                 "ignoring large orphan tx (size: %u, hash: %s)\n", sz,
+                 txid.ToString());
+        return false;
+    }
+
+    std::vector<TxId> &peerOrphans = m_peer_orphans[peer];
+    OrphanEntry entry;
+    entry.tx = tx;
+    entry.fromPeer = peer;
+    entry.nTimeExpire = nTimeExpire;
+    entry.listPos = m_orphan_list.size();
+    entry.peerPos = peerOrphans.size();
+    auto ret = m_orphans.emplace(txid, std::move(entry));
+    assert(ret.second);
+    m_orphan_list.push_back(txid);
+    peerOrphans.push_back(txid);
+    for (const CTxIn &txin : tx->vin) {
+        m_outpoint_to_orphans[txin.prevout].push_back(txid);
+    }
+    m_total_bytes += sz;
+
+    LogPrint(BCLog::MEMPOOL, "stored orphan tx %s (mapsz %u outsz %u)\n",
+             txid.ToString(), m_orphans.size(), m_outpoint_to_orphans.size());
+    return true;
+}
+
+bool CTxOrphanPool::HaveTx(const TxId &txid) const {
+    return m_orphans.count(txid) > 0;
+}
+
+const CTxOrphanPool::Entry *CTxOrphanPool::GetTx(const TxId &txid) const {
+    auto it = m_orphans.find(txid);
+    return it == m_orphans.end() ? nullptr : &it->second;
+}
+
+/**
+ * Remove the element at position pos from v by moving the last element in its
+ * place. Returns the element that was moved, if any.
+ */
+static const TxId *SwapRemove(std::vector<TxId> &v, size_t pos) {
+    assert(pos < v.size());
+    const bool isLast = pos + 1 == v.size();
+    if (!isLast) {
+        v[pos] = v.back();
+    }
+    v.pop_back();
+    return isLast ? nullptr : &v[pos];
+}
+
+void CTxOrphanPool::EraseEntry(OrphanMap::iterator it) {
+    const OrphanEntry &entry = it->second;
+    const TxId &txid = it->first;
+
+    for (const CTxIn &txin : entry.tx->vin) {
+        auto itPrev = m_outpoint_to_orphans.find(txin.prevout);
+        if (itPrev == m_outpoint_to_orphans.end()) {
+            continue;
+        }
+
+        std::vector<TxId> &spenders = itPrev->second;
+        spenders.erase(std::remove(spenders.begin(), spenders.end(), txid),
+                       spenders.end());
+        if (spenders.empty()) {
+            m_outpoint_to_orphans.erase(itPrev);
+        }
+    }
+
+    if (const TxId *moved = SwapRemove(m_orphan_list, entry.listPos)) {
+        m_orphans.at(*moved).listPos = entry.listPos;
+    }
+
+    auto itPeer = m_peer_orphans.find(entry.fromPeer);
+    assert(itPeer != m_peer_orphans.end());
+    if (const TxId *moved = SwapRemove(itPeer->second, entry.peerPos)) {
+        m_orphans.at(*moved).peerPos = entry.peerPos;
+    }
+    if (itPeer->second.empty()) {
+        m_peer_orphans.erase(itPeer);
+    }
+
+    m_total_bytes -= entry.tx->GetTotalSize();
+    m_orphans.erase(it);
+}
+
+int CTxOrphanPool::EraseTx(const TxId &txid) {
+    auto it = m_orphans.find(txid);
+    if (it == m_orphans.end()) {
+        return 0;
+    }
+
+    EraseEntry(it);
+    return 1;
+}
+
+int CTxOrphanPool::EraseForPeer(NodeId peer) {
+    auto itPeer = m_peer_orphans.find(peer);
+    if (itPeer == m_peer_orphans.end()) {
+        return 0;
+    }
+
+    // EraseEntry removes the peer's list once it becomes empty, so work on a
+    // copy.
+    const std::vector<TxId> peerOrphans = itPeer->second;
+    int nErased = 0;
+    for (const TxId &txid : peerOrphans) {
+        nErased += EraseTx(txid);
+    }
+
+    if (nErased > 0) {
+        LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx from peer=%d\n", nErased,
+                 peer);
+    }
+    return nErased;
+}
+
+int CTxOrphanPool::EraseForBlock(const CBlock &block) {
+    std::vector<TxId> vOrphanErase;
+
+    for (const CTransactionRef &ptx : block.vtx) {
+        // Which orphan pool entries must we evict?
+        for (const auto &txin : ptx->vin) {
+            GetChildren(txin.prevout, vOrphanErase);
+        }
+    }
+
+    // Erase orphan transactions included or precluded by this block
+    int nErased = 0;
+    for (const TxId &orphanId : vOrphanErase) {
+        nErased += EraseTx(orphanId);
+    }
+
+    if (nErased > 0) {
+        LogPrint(BCLog::MEMPOOL,
+                 "Erased %d orphan tx included or conflicted by block\n",
+                 nErased);
+    }
+    return nErased;
+}
+
+int CTxOrphanPool::EraseExpired(int64_t nNow, int64_t &nMinExpTime) {
+    std::vector<TxId> vExpired;
+    for (const auto &orphan : m_orphans) {
+        if (orphan.second.nTimeExpire <= nNow) {
+            vExpired.push_back(orphan.first);
+        } else {
+            nMinExpTime = std::min(orphan.second.nTimeExpire, nMinExpTime);
+        }
+    }
+
+    int nErased = 0;
+    for (const TxId &txid : vExpired) {
+        nErased += EraseTx(txid);
+    }
+
+    if (nErased > 0) {
+        LogPrint(BCLog::MEMPOOL, "Erased %d orphan tx due to expiration\n",
+                 nErased);
+    }
+    return nErased;
+}
+
+unsigned int CTxOrphanPool::LimitSize(size_t nMaxOrphans, size_t nMaxBytes,
+                                      FastRandomContext &rng) {
+    unsigned int nEvicted = 0;
+    while (!m_orphan_list.empty() &&
+           (m_orphans.size() > nMaxOrphans || m_total_bytes > nMaxBytes)) {
+        // Evict a random orphan:
+        const size_t pos = rng.randrange(m_orphan_list.size());
+        EraseTx(m_orphan_list[pos]);
+        ++nEvicted;
+    }
+    return nEvicted;
+}
+
+void CTxOrphanPool::GetChildren(const COutPoint &outpoint,
+                                std::vector<TxId> &vOrphans) const {
+    auto itByPrev = m_outpoint_to_orphans.find(outpoint);
+    if (itByPrev == m_outpoint_to_orphans.end()) {
+        return;
+    }
+
+    vOrphans.insert(vOrphans.end(), itByPrev->second.begin(),
+                    itByPrev->second.end());
+}
+
+void CTxOrphanPool::GetSpentOutputs(const std::vector<CTransactionRef> &vtx,
+                                    std::vector<COutPoint> &vOutpoints) const {
+    if (m_orphans.empty()) {
+        return;
+    }
+
+    for (const CTransactionRef &ptx : vtx) {
+        const TxId &txid = ptx->GetId();
+        for (uint32_t i = 0; i < ptx->vout.size(); i++) {
+            const COutPoint outpoint(txid, i);
+            if (m_outpoint_to_orphans.count(outpoint)) {
+                vOutpoints.push_back(outpoint);
+            }
+        }
+    }
+}
+
+size_t CTxOrphanPool::PeerCount(NodeId peer) const {
+    auto itPeer = m_peer_orphans.find(peer);
+    return itPeer == m_peer_orphans.end() ? 0 : itPeer->second.size();
+}
+
+void CTxOrphanPool::Clear() {
+    m_orphans.clear();
+    m_outpoint_to_orphans.clear();
+    m_peer_orphans.clear();
+    m_orphan_list.clear();
+    m_total_bytes = 0;
+}
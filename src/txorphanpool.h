@@ -0,0 +1,127 @@
+// Copyright (c) 2009-2010 Satoshi Nakamoto
+// Copyright (c) 2009-2016 The Bitcoin Core developers
+// Copyright (c) 2020 The Bitcoin developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_TXORPHANPOOL_H
+#define BITCOIN_TXORPHANPOOL_H
+
+#include <coins.h>
+#include <primitives/transaction.h>
+#include <txmempool.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class CBlock;
+class FastRandomContext;
+
+// Same as in net.h, which is not included to keep this header light.
+typedef int64_t NodeId;
+
+/**
+ * A pool of orphan transactions, i.e. transactions whose parents are not known
+ * yet.
+ *
+ * All lookups are hashed: orphans are indexed by txid, by the outpoints they
+ * spend and by the peer that sent them. Orphans are also kept in a flat array
+ * so that a random one can be evicted in constant time.
+ *
+ * This class does no locking on its own, the caller is responsible for
+ * serializing accesses.
+ */
+class CTxOrphanPool {
+public:
+    struct Entry {
+        CTransactionRef tx;
+        NodeId fromPeer;
+        int64_t nTimeExpire;
+    };
+
+    /**
+     * Add a new orphan transaction. Returns false if the transaction is
+     * already in the pool or too large to be stored.
+     */
+    bool AddTx(const CTransactionRef &tx, NodeId peer, int64_t nTimeExpire);
+
+    /** Check if an orphan with the given txid is in the pool. */
+    bool HaveTx(const TxId &txid) const;
+
+    /** Return the orphan with the given txid, or nullptr if not found. */
+    const Entry *GetTx(const TxId &txid) const;
+
+    /** Erase an orphan by txid. Returns the number of orphans erased. */
+    int EraseTx(const TxId &txid);
+
+    /** Erase all orphans received from the given peer. */
+    int EraseForPeer(NodeId peer);
+
+    /**
+     * Erase all orphans that are included in or conflict with the given
+     * block.
+     */
+    int EraseForBlock(const CBlock &block);
+
+    /** Erase all orphans which expired before nNow. */
+    int EraseExpired(int64_t nNow, int64_t &nMinExpTime);
+
+    /**
+     * Evict random orphans until the pool holds at most nMaxOrphans
+     * transactions, totaling at most nMaxBytes. Returns the number of orphans
+     * evicted.
+     */
+    unsigned int LimitSize(size_t nMaxOrphans, size_t nMaxBytes,
+                           FastRandomContext &rng);
+
+    /**
+     * Append to vOrphans the txids of all the orphans spending the given
+     * outpoint.
+     */
+    void GetChildren(const COutPoint &outpoint,
+                     std::vector<TxId> &vOrphans) const;
+
+    /**
+     * Append to vOutpoints the outputs of the given transactions that are
+     * spent by orphans, so that these orphans can be reconsidered.
+     */
+    void GetSpentOutputs(const std::vector<CTransactionRef> &vtx,
+                         std::vector<COutPoint> &vOutpoints) const;
+
+    size_t Size() const { return m_orphans.size(); }
+    size_t TotalBytes() const { return m_total_bytes; }
+    size_t PeerCount(NodeId peer) const;
+
+    void Clear();
+
+private:
+    struct OrphanEntry : public Entry {
+        //! Position of this orphan in m_orphan_list.
+        size_t listPos;
+        //! Position of this orphan in m_peer_orphans[fromPeer].
+        size_t peerPos;
+    };
+
+    using OrphanMap = std::unordered_map<TxId, OrphanEntry, SaltedTxidHasher>;
+
+    OrphanMap m_orphans;
+
+    //! Orphans indexed by the outpoints they spend. It is rare for several
+    //! orphans to spend the same outpoint, so a flat vector is enough.
+    std::unordered_map<COutPoint, std::vector<TxId>, SaltedOutpointHasher>
+        m_outpoint_to_orphans;
+
+    //! Orphans received from each peer.
+    std::unordered_map<NodeId, std::vector<TxId>> m_peer_orphans;
+
+    //! All the orphans, in no particular order, for random eviction.
+    std::vector<TxId> m_orphan_list;
+
+    //! Sum of the serialized size of all the orphans.
+    size_t m_total_bytes = 0;
+
+    void EraseEntry(OrphanMap::iterator it);
+};
+
+#endif // BITCOIN_TXORPHANPOOL_H
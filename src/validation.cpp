@@ -52,10 +52,13 @@
 #include <boost/thread.hpp> // boost::this_thread::interruption_point() (mingw)
 
 #include <atomic>
+#include <functional>
 #include <future>
+#include <queue>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <unordered_map>
 
 #include <core_io.h> // For debugging
 #include <key_io.h>  // For debugging
@@ -5730,6 +5733,139 @@ int VersionBitsTipStateSinceHeight(const Consensus::Params &params,
 
 static const uint64_t MEMPOOL_DUMP_VERSION = 1;
 
+/**
+ * Maximum number of script checks handed to the script check threads at once
+ * by PrevalidateTransactionScripts. The check queue is released between
+ * chunks, so that ConnectBlock, which needs it too, never waits for a whole
+ * batch.
+ */
+static const size_t PREVALIDATION_CHECK_CHUNK_SIZE = 128;
+
+void SortMempoolBatchByAncestry(std::vector<MempoolLoadEntry> &batch) {
+    std::unordered_map<TxId, size_t, SaltedTxidHasher> positions;
+    positions.reserve(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        positions.emplace(batch[i].tx->GetId(), i);
+    }
+
+    // This is Kahn's algorithm: nParents[i] is the number of in-batch parents
+    // of batch[i] not sorted yet and children[i] the entries spending
+    // batch[i], in increasing order.
+    std::vector<size_t> nParents(batch.size(), 0);
+    std::vector<std::vector<size_t>> children(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        for (const CTxIn &txin : batch[i].tx->vin) {
+            auto it = positions.find(txin.prevout.GetTxId());
+            if (it == positions.end() || it->second == i) {
+                continue;
+            }
+
+            // Count a parent only once, even if several of its outputs are
+            // spent.
+            std::vector<size_t> &siblings = children[it->second];
+            if (!siblings.empty() && siblings.back() == i) {
+                continue;
+            }
+            siblings.push_back(i);
+            nParents[i]++;
+        }
+    }
+
+    // Always pick the ready entry which comes first in the batch, so that the
+    // relative order of unrelated transactions is preserved.
+    std::priority_queue<size_t, std::vector<size_t>, std::greater<size_t>>
+        ready;
+    for (size_t i = 0; i < batch.size(); i++) {
+        if (nParents[i] == 0) {
+            ready.push(i);
+        }
+    }
+
+    std::vector<MempoolLoadEntry> sorted;
+    sorted.reserve(batch.size());
+    while (!ready.empty()) {
+        const size_t i = ready.top();
+        ready.pop();
+        sorted.push_back(std::move(batch[i]));
+        for (const size_t child : children[i]) {
+            if (--nParents[child] == 0) {
+                ready.push(child);
+            }
+        }
+    }
+
+    // Transactions cannot form a cycle, so everything has been sorted.
+    assert(sorted.size() == batch.size());
+    batch.swap(sorted);
+}
+
+void PrevalidateTransactionScripts(const Config &config,
+                                   const CTxMemPool &pool,
+                                   const std::vector<CTransactionRef> &vtx) {
+    std::unordered_map<TxId, const CTransaction *, SaltedTxidHasher> batchTxs;
+    batchTxs.reserve(vtx.size());
+    for (const CTransactionRef &ptx : vtx) {
+        batchTxs.emplace(ptx->GetId(), ptx.get());
+    }
+
+    std::vector<std::vector<CScriptCheck>> vChunks(1);
+    {
+        LOCK2(cs_main, pool.cs);
+        const uint32_t flags = GetStandardScriptFlags(
+            config.GetChainParams().GetConsensus(), ::ChainActive().Tip());
+        CCoinsViewMemPool viewMemPool(pcoinsTip.get(), pool);
+
+        std::vector<CTxOut> spent;
+        for (const CTransactionRef &ptx : vtx) {
+            const CTransaction &tx = *ptx;
+            if (tx.IsCoinBase()) {
+                continue;
+            }
+
+            // Gather the outputs spent by this transaction, either from the
+            // batch itself or from the chainstate and mempool. Transactions
+            // with missing inputs are left for AcceptToMemoryPool to reject.
+            spent.clear();
+            for (const CTxIn &txin : tx.vin) {
+                auto it = batchTxs.find(txin.prevout.GetTxId());
+                if (it != batchTxs.end()) {
+                    if (txin.prevout.GetN() >= it->second->vout.size()) {
+                        break;
+                    }
+                    spent.push_back(it->second->vout[txin.prevout.GetN()]);
+                    continue;
+                }
+
+                Coin coin;
+                if (!viewMemPool.GetCoin(txin.prevout, coin)) {
+                    break;
+                }
+                spent.push_back(coin.GetTxOut());
+            }
+
+            if (spent.size() != tx.vin.size()) {
+                continue;
+            }
+
+            PrecomputedTransactionData txdata(tx);
+            for (size_t i = 0; i < tx.vin.size(); i++) {
+                if (vChunks.back().size() >= PREVALIDATION_CHECK_CHUNK_SIZE) {
+                    vChunks.emplace_back();
+                }
+                vChunks.back().emplace_back(
+                    spent[i].scriptPubKey, spent[i].nValue, tx, i, flags,
+                    true /* cacheStore */, txdata);
+            }
+        }
+    }
+
+    for (std::vector<CScriptCheck> &vChecks : vChunks) {
+        CCheckQueueControl<CScriptCheck> control(&scriptcheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    }
+}
+
 bool LoadMempool(const Config &config, CTxMemPool &pool) {
     int64_t nExpiryTimeout =
         gArgs.GetArg("-mempoolexpiry", DEFAULT_MEMPOOL_EXPIRY) * 60 * 60;
@@ -5756,25 +5892,54 @@ bool LoadMempool(const Config &config, CTxMemPool &pool) {
 
         uint64_t num;
         file >> num;
-        while (num--) {
-            CTransactionRef tx;
-            int64_t nTime;
-            int64_t nFeeDelta;
-            file >> tx;
-            file >> nTime;
-            file >> nFeeDelta;
-
-            Amount amountdelta = nFeeDelta * SATOSHI;
-            if (amountdelta != Amount::zero()) {
-                pool.PrioritiseTransaction(tx->GetId(), amountdelta);
+
+        const uint64_t total = num;
+        int reportDone = 0;
+        uiInterface.ShowProgress(_("Loading mempool..."), 0, false);
+
+        std::vector<MempoolLoadEntry> batch;
+        while (num > 0) {
+            // Read the next batch of entries from the file.
+            batch.clear();
+            while (num > 0 && batch.size() < MEMPOOL_LOAD_BATCH_SIZE) {
+                num--;
+                CTransactionRef tx;
+                int64_t nTime;
+                int64_t nFeeDelta;
+                file >> tx;
+                file >> nTime;
+                file >> nFeeDelta;
+
+                Amount amountdelta = nFeeDelta * SATOSHI;
+                if (amountdelta != Amount::zero()) {
+                    pool.PrioritiseTransaction(tx->GetId(), amountdelta);
+                }
+
+                if (nTime + nExpiryTimeout > nNow) {
+                    batch.push_back({std::move(tx), nTime});
+                } else {
+                    ++expired;
+                }
+            }
+
+            // Validate scripts in parallel, then accept the transactions
+            // parents first.
+            SortMempoolBatchByAncestry(batch);
+            std::vector<CTransactionRef> vtx;
+            vtx.reserve(batch.size());
+            for (const MempoolLoadEntry &entry : batch) {
+                vtx.push_back(entry.tx);
             }
-            CValidationState state;
-            if (nTime + nExpiryTimeout > nNow) {
+            PrevalidateTransactionScripts(config, pool, vtx);
+
+            for (const MempoolLoadEntry &entry : batch) {
+                CValidationState state;
                 LOCK(cs_main);
                 AcceptToMemoryPoolWithTime(
-                    config, pool, state, tx, nullptr /* pfMissingInputs */,
-                    nTime, false /* bypass_limits */,
-                    Amount::zero() /* nAbsurdFee */, false /* test_accept */);
+                    config, pool, state, entry.tx,
+                    nullptr /* pfMissingInputs */, entry.nTime,
+                    false /* bypass_limits */, Amount::zero() /* nAbsurdFee */,
+                    false /* test_accept */);
                 if (state.IsValid()) {
                     ++count;
                 } else {
@@ -5782,20 +5947,30 @@ bool LoadMempool(const Config &config, CTxMemPool &pool) {
                     // wallet(s) having loaded it while we were processing
                     // mempool transactions; consider these as valid, instead of
                     // failed, but mark them as 'already there'
-                    if (pool.exists(tx->GetId())) {
+                    if (pool.exists(entry.tx->GetId())) {
                         ++already_there;
                     } else {
                         ++failed;
                     }
                 }
-            } else {
-                ++expired;
             }
 
             if (ShutdownRequested()) {
+                uiInterface.ShowProgress("", 100, false);
                 return false;
             }
+
+            const int percentageDone = int((total - num) * 100 / total);
+            if (reportDone < percentageDone / 10) {
+                reportDone = percentageDone / 10;
+                LogPrintf("Loading mempool: %d%% (%i/%i)\n", percentageDone,
+                          total - num, total);
+            }
+            uiInterface.ShowProgress(_("Loading mempool..."), percentageDone,
+                                     false);
         }
+        uiInterface.ShowProgress("", 100, false);
+
         std::map<TxId, Amount> mapDeltas;
         file >> mapDeltas;
 
@@ -5803,6 +5978,7 @@ bool LoadMempool(const Config &config, CTxMemPool &pool) {
             pool.PrioritiseTransaction(i.first, i.second);
         }
     } catch (const std::exception &e) {
+        uiInterface.ShowProgress("", 100, false);
         LogPrintf("Failed to deserialize mempool data on disk: %s. Continuing "
                   "anyway.\n",
                   e.what());
@@ -5846,12 +6022,24 @@ bool DumpMempool(const CTxMemPool &pool) {
         uint64_t version = MEMPOOL_DUMP_VERSION;
         file << version;
 
-        file << uint64_t(vinfo.size());
+        // The snapshot is serialized without holding pool.cs, so the mempool
+        // remains usable while a large dump is written.
+        const size_t total = vinfo.size();
+        size_t done = 0;
+        int reportDone = 0;
+        file << uint64_t(total);
         for (const auto &i : vinfo) {
             file << *(i.tx);
             file << int64_t(i.nTime);
             file << i.nFeeDelta;
             mapDeltas.erase(i.tx->GetId());
+
+            const int percentageDone = int(++done * 100 / total);
+            if (reportDone < percentageDone / 10) {
+                reportDone = percentageDone / 10;
+                LogPrint(BCLog::MEMPOOL, "Dumping mempool: %d%% (%u/%u)\n",
+                         percentageDone, done, total);
+            }
         }
 
         file << mapDeltas;
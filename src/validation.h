@@ -813,6 +813,46 @@ bool DumpMempool(const CTxMemPool &pool);
 /** Load the mempool from disk. */
 bool LoadMempool(const Config &config, CTxMemPool &pool);
 
+/**
+ * Number of transactions read from mempool.dat and validated together when
+ * loading the mempool.
+ */
+static const size_t MEMPOOL_LOAD_BATCH_SIZE = 1000;
+
+/** A mempool.dat entry waiting to be accepted to the mempool. */
+struct MempoolLoadEntry {
+    CTransactionRef tx;
+    int64_t nTime;
+};
+
+/**
+ * Sort a batch of mempool.dat entries so that every transaction comes after
+ * its parents. The relative order of unrelated transactions is preserved, so
+ * a dump that is already topologically sorted is left as is.
+ *
+ * Only parents within the batch are considered: LoadMempool sorts each batch
+ * of MEMPOOL_LOAD_BATCH_SIZE entries independently, so a child stored in an
+ * earlier batch than its parent is still rejected for missing inputs.
+ */
+void SortMempoolBatchByAncestry(std::vector<MempoolLoadEntry> &batch);
+
+/**
+ * Run the script checks of the given transactions on the script check threads
+ * using the standard flags, storing valid signatures in the signature cache.
+ * This makes accepting these transactions to the mempool afterwards cheap, as
+ * AcceptToMemoryPool no longer needs to verify the signatures itself.
+ * Transactions may spend the outputs of the ones before them in vtx.
+ *
+ * Results are deliberately ignored: mempool acceptance remains authoritative
+ * and reports failures. A failing check may cause the queue to skip the
+ * remaining checks of its chunk, which only makes the acceptance pass slower.
+ *
+ * The caller may hold cs_main, but not pool.cs.
+ */
+void PrevalidateTransactionScripts(const Config &config,
+                                   const CTxMemPool &pool,
+                                   const std::vector<CTransactionRef> &vtx);
+
 //! Check whether the block associated with this index entry is pruned or not.
 bool IsBlockPruned(const CBlockIndex *pblockindex);
 
@@ -33,18 +33,44 @@ Test is as follows:
     mempool.
   - Verify that savemempool throws when the RPC is called if
     node1 can't write to disk.
+  - Create more transactions on node1 than are loaded in a single batch,
+    including chains of unconfirmed transactions. Restart node1 and verify
+    that they are all loaded back.
 
 """
 from decimal import Decimal
 import os
 
+from test_framework.address import script_to_p2sh
+from test_framework.messages import (
+    COutPoint,
+    CTransaction,
+    CTxIn,
+    CTxOut,
+    ToHex,
+)
+from test_framework.script import (
+    CScript,
+    hash160,
+    OP_EQUAL,
+    OP_HASH160,
+    OP_TRUE,
+)
 from test_framework.test_framework import BitcoinTestFramework
+from test_framework.txtools import pad_tx
 from test_framework.util import (
     assert_equal,
     assert_raises_rpc_error,
     wait_until
 )
 
+# Keep in sync with MEMPOOL_LOAD_BATCH_SIZE in validation.h
+MEMPOOL_LOAD_BATCH_SIZE = 1000
+
+REDEEM_SCRIPT = CScript([OP_TRUE])
+P2SH_SCRIPT = CScript([OP_HASH160, hash160(REDEEM_SCRIPT), OP_EQUAL])
+FEE = 1000
+
 
 class MempoolPersistTest(BitcoinTestFramework):
     def set_test_params(self):
@@ -140,6 +166,54 @@ class MempoolPersistTest(BitcoinTestFramework):
                                 self.nodes[1].savemempool)
         os.rmdir(mempooldotnew1)
 
+        self.log.debug(
+            "Send more than MEMPOOL_LOAD_BATCH_SIZE transactions to node1. "
+            "Verify that they are all loaded back after a restart.")
+        self.test_load_many_transactions(self.nodes[1])
+
+    def test_load_many_transactions(self, node):
+        def spend(prevout, values):
+            tx = CTransaction()
+            tx.vin.append(CTxIn(prevout, CScript([REDEEM_SCRIPT])))
+            for value in values:
+                tx.vout.append(CTxOut(value, P2SH_SCRIPT))
+            pad_tx(tx)
+            tx.rehash()
+            node.sendrawtransaction(ToHex(tx))
+            return tx
+
+        # Mine a spendable coinbase, then fan it out in a confirmed
+        # transaction so the chains below don't hit the descendant limit.
+        address = script_to_p2sh(REDEEM_SCRIPT)
+        coinbase_hash = node.generatetoaddress(1, address)[0]
+        node.generatetoaddress(100, address)
+        coinbase = node.getblock(coinbase_hash, 2)['tx'][0]
+        coinbase_value = int(coinbase['vout'][0]['value'] * 100000000)
+
+        num_chains = MEMPOOL_LOAD_BATCH_SIZE // 2 + 100
+        # The fan-out transaction is large, pay a fee for each output.
+        chain_value = coinbase_value // num_chains - FEE
+        fanout = spend(COutPoint(int(coinbase['txid'], 16), 0),
+                       [chain_value] * num_chains)
+        node.generatetoaddress(1, address)
+        assert_equal(node.getrawmempool(), [])
+
+        # Each chain is a parent and a child, so the dump spans several
+        # batches and some children are stored in the same batch as their
+        # parent.
+        for i in range(num_chains):
+            parent = spend(COutPoint(fanout.sha256, i), [chain_value - FEE])
+            spend(COutPoint(parent.sha256, 0), [chain_value - 2 * FEE])
+        txids = node.getrawmempool()
+        assert_equal(len(txids), 2 * num_chains)
+        assert len(txids) > MEMPOOL_LOAD_BATCH_SIZE
+
+        self.stop_nodes()
+        self.start_node(1, extra_args=[])
+        node = self.nodes[1]
+        wait_until(lambda: node.getmempoolinfo()["loaded"])
+        assert_equal(sorted(node.getrawmempool()), sorted(txids))
+
 
 if __name__ == '__main__':
     MempoolPersistTest().main()
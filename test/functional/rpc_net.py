@@ -80,6 +80,16 @@ class NetTest(BitcoinTestFramework):
             assert_greater_than_or_equal(
                 after['bytessent_per_msg']['ping'], before['bytessent_per_msg']['ping'] + 32)
 
+        # the pongs are accounted in the message latency statistics
+        wait_until(lambda: 'pong' in self.nodes[0].getnettotals()[
+                   'msglatency'], timeout=1)
+        pong_latency = self.nodes[0].getnettotals()['msglatency']['pong']
+        assert_greater_than_or_equal(pong_latency['count'], 2)
+        assert_greater_than_or_equal(
+            pong_latency['maxlatency'], pong_latency['avglatency'])
+        assert_greater_than_or_equal(
+            pong_latency['avglatency'], pong_latency['avgprocessingtime'])
+
     def _test_getnetworkinginfo(self):
         assert_equal(self.nodes[0].getnetworkinfo()['networkactive'], True)
         assert_equal(self.nodes[0].getnetworkinfo()['connections'], 2)